@@ -1,12 +1,36 @@
 #include "fmt/core.h"
 #include "libassert/assert.hpp"
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <fstream>
-#include <map>
+#include <limits>
+#include <numeric>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
+
+/// antennas are tuned to a digit, an uppercase or a lowercase letter
+static constexpr std::size_t NUM_FREQUENCIES{10 + 26 + 26};
+static constexpr std::size_t NO_FREQUENCY{NUM_FREQUENCIES};
+
+/// the bucket of the frequency of a cell: digits first, then uppercase and
+/// lowercase letters, and `NO_FREQUENCY` for anything else
+constexpr std::size_t
+frequency_of(char cell) {
+  if (cell >= '0' && cell <= '9') {
+    return static_cast<std::size_t>(cell - '0');
+  }
+  if (cell >= 'A' && cell <= 'Z') {
+    return 10 + static_cast<std::size_t>(cell - 'A');
+  }
+  if (cell >= 'a' && cell <= 'z') {
+    return 36 + static_cast<std::size_t>(cell - 'a');
+  }
+  return NO_FREQUENCY;
+}
 
 struct Location
 {
@@ -20,51 +44,24 @@ struct Location
   }
 };
 
-class Antenna
+/// the antennas of every frequency, stored back to back in one row and one
+/// column array: the antennas of `frequency` are `offsets[frequency]` up to
+/// `offsets[frequency + 1]`
+struct AntennaIndex
 {
-private:
-  Location m_loc;
-
-public:
-  Antenna(std::int64_t row, std::int64_t col) : m_loc{row, col} {}
-  [[nodiscard]] std::pair<Location, Location>
-  get_antinodes(Antenna const &other) const {
-    std::int64_t row_diff{std::abs(m_loc.m_row - other.m_loc.m_row)};
-    std::int64_t col_diff{std::abs(m_loc.m_col - other.m_loc.m_col)};
-    if (m_loc.m_row <= other.m_loc.m_row) {
-      if (m_loc.m_col <= other.m_loc.m_col) {
-        // 1....
-        // .A...
-        // .....
-        // ...a.
-        // ....2
-        return {{m_loc.m_row - row_diff, m_loc.m_col - col_diff},
-                {other.m_loc.m_row + row_diff, other.m_loc.m_col + col_diff}};
-      }
-      // ....1
-      // ...A.
-      // .....
-      // .a...
-      // 2....
-      return {{m_loc.m_row - row_diff, m_loc.m_col + col_diff},
-              {other.m_loc.m_row + row_diff, other.m_loc.m_col - col_diff}};
-    }
-    if (m_loc.m_col <= other.m_loc.m_col) {
-      // ....1
-      // ...a.
-      // .....
-      // .A...
-      // 2....
-      return {{m_loc.m_row + row_diff, m_loc.m_col - col_diff},
-              {other.m_loc.m_row - row_diff, other.m_loc.m_col + col_diff}};
-    }
-    // 2....
-    // .a...
-    // .....
-    // ...A.
-    // ....1
-    return {{m_loc.m_row + row_diff, m_loc.m_col + col_diff},
-            {other.m_loc.m_row - row_diff, other.m_loc.m_col - col_diff}};
+  std::vector<std::int32_t> rows;
+  std::vector<std::int32_t> cols;
+  std::array<std::uint32_t, NUM_FREQUENCIES + 1> offsets{};
+
+  [[nodiscard]] std::size_t
+  size(std::size_t frequency) const {
+    return offsets[frequency + 1] - offsets[frequency];
+  }
+
+  [[nodiscard]] Location
+  location(std::size_t frequency, std::size_t idx) const {
+    std::size_t const pos = offsets[frequency] + idx;
+    return {rows[pos], cols[pos]};
   }
 };
 
@@ -72,10 +69,16 @@ static void
 tests();
 static std::uint64_t
 get_num_antinodes(std::ranges::range auto &&lines);
-static std::map<char, std::vector<Antenna>>
+static AntennaIndex
 parse_antenas(std::ranges::range auto &&lines,
               std::size_t num_rows,
               std::size_t num_cols);
+static std::vector<std::vector<bool>>
+build_antinode_grid(AntennaIndex const &index,
+                    std::size_t num_rows,
+                    std::size_t num_cols);
+static std::pair<Location, Location>
+get_antinodes(Location const &antenna1, Location const &antenna2);
 static std::uint64_t
 count_antinodes(std::vector<std::vector<bool>> const &antinode_grid);
 
@@ -121,47 +124,83 @@ tests() {
                             "............"sv}};
 
   ASSERT(get_num_antinodes(lines) == 14);
+
+  static_assert(frequency_of('0') == 0 && frequency_of('9') == 9);
+  static_assert(frequency_of('A') == 10 && frequency_of('Z') == 35);
+  static_assert(frequency_of('a') == 36 && frequency_of('z') == 61);
+  static_assert(frequency_of('.') == NO_FREQUENCY
+                && frequency_of('#') == NO_FREQUENCY);
+
+  // only antennas of the same frequency, case included, make antinodes
+  auto cased = std::vector{{"...."sv, ".a.."sv, "..A."sv, "...."sv}};
+  ASSERT(get_num_antinodes(cased) == 0);
+  auto paired = std::vector{{"...."sv, ".z.."sv, "..z."sv, "...."sv}};
+  ASSERT(get_num_antinodes(paired) == 2);
 }
 
 std::uint64_t
 get_num_antinodes(std::ranges::range auto &&lines) {
   std::size_t const num_rows = lines.size();
   std::size_t const num_cols = lines[0].size();
-  auto const antenna_map = parse_antenas(lines, num_rows, num_cols);
+  auto const antenna_index = parse_antenas(lines, num_rows, num_cols);
   auto const antinode_grid =
-      build_antinode_grid(antenna_map, num_rows, num_cols);
+      build_antinode_grid(antenna_index, num_rows, num_cols);
 
   return count_antinodes(antinode_grid);
 }
 
-std::map<char, std::vector<Antenna>>
+/// classifies every cell in a single pass over the grid, and then groups the
+/// antennas by frequency with a counting sort, keeping them in reading order
+AntennaIndex
 parse_antenas(std::ranges::range auto &&lines,
               std::size_t num_rows,
               std::size_t num_cols) {
-  std::map<char, std::vector<Antenna>> antennas;
+  ASSERT(num_rows <= std::numeric_limits<std::int32_t>::max()
+         && num_cols <= std::numeric_limits<std::int32_t>::max());
+  std::vector<std::uint8_t> frequencies;
+  std::vector<std::int32_t> rows;
+  std::vector<std::int32_t> cols;
+  AntennaIndex index;
   for (std::size_t row{0}; row < num_rows; ++row) {
     for (std::size_t col{0}; col < num_cols; ++col) {
-      if (lines[row][col] == '.') {
+      std::size_t const frequency = frequency_of(lines[row][col]);
+      if (frequency == NO_FREQUENCY) {
         continue;
       }
-      antennas[lines[row][col]].emplace_back(row, col);
+      frequencies.push_back(static_cast<std::uint8_t>(frequency));
+      rows.push_back(static_cast<std::int32_t>(row));
+      cols.push_back(static_cast<std::int32_t>(col));
+      ++index.offsets[frequency + 1];
     }
   }
-  return antennas;
+
+  std::partial_sum(
+      index.offsets.begin(), index.offsets.end(), index.offsets.begin());
+  std::array<std::uint32_t, NUM_FREQUENCIES> next{};
+  std::copy_n(index.offsets.begin(), NUM_FREQUENCIES, next.begin());
+  index.rows.resize(rows.size());
+  index.cols.resize(cols.size());
+  for (std::size_t idx{}; idx < frequencies.size(); ++idx) {
+    std::uint32_t const pos = next[frequencies[idx]]++;
+    index.rows[pos] = rows[idx];
+    index.cols[pos] = cols[idx];
+  }
+  return index;
 }
 
 std::vector<std::vector<bool>>
-build_antinode_grid(std::map<char, std::vector<Antenna>> const &antenna_map,
+build_antinode_grid(AntennaIndex const &index,
                     std::size_t num_rows,
                     std::size_t num_cols) {
   std::vector<std::vector<bool>> antinode_grid(num_rows,
                                                std::vector(num_cols, false));
-  for (auto const &[key, antennas] : antenna_map) {
-    std::size_t const num_antennas = antennas.size();
-    for (std::size_t idx1{0}; idx1 < num_antennas - 1; ++idx1) {
+  for (std::size_t frequency{}; frequency < NUM_FREQUENCIES; ++frequency) {
+    std::size_t const num_antennas = index.size(frequency);
+    for (std::size_t idx1{0}; idx1 < num_antennas; ++idx1) {
+      Location const antenna1 = index.location(frequency, idx1);
       for (std::size_t idx2{idx1 + 1}; idx2 < num_antennas; ++idx2) {
         auto const [antinode1, antinode2] =
-            antennas[idx1].get_antinodes(antennas[idx2]);
+            get_antinodes(antenna1, index.location(frequency, idx2));
         if (antinode1.is_in_grid(num_rows, num_cols)) {
           antinode_grid[antinode1.m_row][antinode1.m_col] = true;
         }
@@ -174,6 +213,16 @@ build_antinode_grid(std::map<char, std::vector<Antenna>> const &antenna_map,
   return antinode_grid;
 }
 
+/// the two antinodes of a pair of antennas, each as far beyond one antenna as
+/// the other antenna is before it
+std::pair<Location, Location>
+get_antinodes(Location const &antenna1, Location const &antenna2) {
+  return {{(2 * antenna1.m_row) - antenna2.m_row,
+           (2 * antenna1.m_col) - antenna2.m_col},
+          {(2 * antenna2.m_row) - antenna1.m_row,
+           (2 * antenna2.m_col) - antenna1.m_col}};
+}
+
 std::uint64_t
 count_antinodes(std::vector<std::vector<bool>> const &antinode_grid) {
   std::uint64_t num_antinodes{};
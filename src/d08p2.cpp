@@ -1,130 +1,102 @@
 #include "fmt/core.h"
 #include "libassert/assert.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <fstream>
-#include <map>
+#include <limits>
+#include <numeric>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
-struct Location
-{
-  std::int64_t m_row;
-  std::int64_t m_col;
+#include "BS_thread_pool.hpp"
 
-  [[nodiscard]] bool
-  is_in_grid(std::size_t num_rows, std::size_t num_cols) const {
-    return m_row >= 0 && m_col >= 0 && static_cast<std::size_t>(m_row) < num_rows
-           && static_cast<std::size_t>(m_col) < num_cols;
+/// antennas are tuned to a digit, an uppercase or a lowercase letter
+static constexpr std::size_t NUM_FREQUENCIES{10 + 26 + 26};
+static constexpr std::size_t NO_FREQUENCY{NUM_FREQUENCIES};
+
+/// the bucket of the frequency of a cell: digits first, then uppercase and
+/// lowercase letters, and `NO_FREQUENCY` for anything else
+constexpr std::size_t
+frequency_of(char cell) {
+  if (cell >= '0' && cell <= '9') {
+    return static_cast<std::size_t>(cell - '0');
   }
-};
+  if (cell >= 'A' && cell <= 'Z') {
+    return 10 + static_cast<std::size_t>(cell - 'A');
+  }
+  if (cell >= 'a' && cell <= 'z') {
+    return 36 + static_cast<std::size_t>(cell - 'a');
+  }
+  return NO_FREQUENCY;
+}
 
-class Antenna
+/// one bit per cell of the grid, with every row starting on a fresh word
+class BitMatrix
 {
 private:
-  Location m_loc;
+  std::size_t m_cols;
+  std::size_t m_words_per_row;
+  std::vector<std::uint64_t> m_words;
 
 public:
-  Antenna(std::int64_t row, std::int64_t col) : m_loc{row, col} {}
-  [[nodiscard]] std::vector<Location>
-  get_antinodes(Antenna const &other,
-                std::size_t num_rows,
-                std::size_t num_cols) const {
-    std::vector<Location> antinodes;
-
-    std::int64_t row_diff{std::abs(m_loc.m_row - other.m_loc.m_row)};
-    std::int64_t col_diff{std::abs(m_loc.m_col - other.m_loc.m_col)};
-    if (m_loc.m_row <= other.m_loc.m_row) {
-      if (m_loc.m_col <= other.m_loc.m_col) {
-        // 1....
-        // .A...
-        // .....
-        // ...a.
-        // ....2
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{m_loc.m_row - i * row_diff, m_loc.m_col - i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{other.m_loc.m_row + i * row_diff,
-                       other.m_loc.m_col + i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-      } else {
-        // ....1
-        // ...A.
-        // .....
-        // .a...
-        // 2....
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{m_loc.m_row - i * row_diff, m_loc.m_col + i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{other.m_loc.m_row + i * row_diff,
-                       other.m_loc.m_col - i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-      }
-    } else {
-      if (m_loc.m_col <= other.m_loc.m_col) {
-        // ....1
-        // ...a.
-        // .....
-        // .A...
-        // 2....
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{m_loc.m_row + i * row_diff, m_loc.m_col - i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{other.m_loc.m_row - i * row_diff,
-                       other.m_loc.m_col + i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-      } else {
-        // 2....
-        // .a...
-        // .....
-        // ...A.
-        // ....1
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{m_loc.m_row + i * row_diff, m_loc.m_col + i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-        for (std::int64_t i = 0;; ++i) {
-          Location loc{other.m_loc.m_row - i * row_diff,
-                       other.m_loc.m_col - i * col_diff};
-          if (!loc.is_in_grid(num_rows, num_cols)) {
-            break;
-          }
-          antinodes.emplace_back(loc);
-        }
-      }
+  BitMatrix(std::size_t num_rows, std::size_t num_cols)
+      : m_cols{num_cols}, m_words_per_row{(num_cols + 63) / 64},
+        m_words(num_rows * m_words_per_row) {}
+
+  void
+  set(std::size_t row, std::size_t col) {
+    m_words[(row * m_words_per_row) + (col / 64)] |= std::uint64_t{1}
+                                                     << (col % 64);
+  }
+
+  BitMatrix &
+  operator|=(BitMatrix const &other) {
+    DEBUG_ASSERT(m_words.size() == other.m_words.size());
+    for (std::size_t idx{}; idx < m_words.size(); ++idx) {
+      m_words[idx] |= other.m_words[idx];
     }
-    return antinodes;
+    return *this;
+  }
+
+  [[nodiscard]] std::uint64_t
+  count() const {
+    std::uint64_t num_set{};
+    for (auto const word : m_words) {
+      num_set += static_cast<std::uint64_t>(std::popcount(word));
+    }
+    return num_set;
+  }
+};
+
+struct Location
+{
+  std::int64_t m_row;
+  std::int64_t m_col;
+};
+
+/// the antennas of every frequency, stored back to back in one row and one
+/// column array: the antennas of `frequency` are `offsets[frequency]` up to
+/// `offsets[frequency + 1]`
+struct AntennaIndex
+{
+  std::vector<std::int32_t> rows;
+  std::vector<std::int32_t> cols;
+  std::array<std::uint32_t, NUM_FREQUENCIES + 1> offsets{};
+
+  [[nodiscard]] std::size_t
+  size(std::size_t frequency) const {
+    return offsets[frequency + 1] - offsets[frequency];
+  }
+
+  [[nodiscard]] Location
+  location(std::size_t frequency, std::size_t idx) const {
+    std::size_t const pos = offsets[frequency] + idx;
+    return {rows[pos], cols[pos]};
   }
 };
 
@@ -132,12 +104,22 @@ static void
 tests();
 static std::uint64_t
 get_num_antinodes(std::ranges::range auto &&lines);
-static std::map<char, std::vector<Antenna>>
+static AntennaIndex
 parse_antenas(std::ranges::range auto &&lines,
               std::size_t num_rows,
               std::size_t num_cols);
-static std::uint64_t
-count_antinodes(std::vector<std::vector<bool>> const &antinode_grid);
+static BitMatrix
+build_antinode_grid(AntennaIndex const &index,
+                    std::size_t num_rows,
+                    std::size_t num_cols);
+static void
+mark_antinodes(Location const &antenna1,
+               Location const &antenna2,
+               BitMatrix &antinodes,
+               std::size_t num_rows,
+               std::size_t num_cols);
+static std::pair<std::int64_t, std::int64_t>
+clip(std::int64_t pos, std::int64_t step, std::int64_t size);
 
 int
 main(int argc, char const *const *argv) {
@@ -181,65 +163,153 @@ tests() {
                             "............"sv}};
 
   ASSERT(get_num_antinodes(lines) == 34);
+
+  // the cells between two antennas are on their line too when the offset
+  // between them has a common divisor
+  auto diagonal = std::vector{{"a...."sv, "....."sv, "..a.."sv, "....."sv,
+                               "....."sv}};
+  ASSERT(get_num_antinodes(diagonal) == 5);
+  // a line going down to the left is clipped by the bottom before the left
+  auto steep = std::vector{{"....b"sv, "....."sv, "...b."sv, "....."sv,
+                            "..b.."sv, "....."sv, ".b..."sv}};
+  ASSERT(get_num_antinodes(steep) == 4);
+
+  // only antennas of the same frequency, case included, share a line
+  auto cased = std::vector{{"...."sv, ".a.."sv, "..A."sv, "...."sv}};
+  ASSERT(get_num_antinodes(cased) == 0);
 }
 
 std::uint64_t
 get_num_antinodes(std::ranges::range auto &&lines) {
   std::size_t const num_rows = lines.size();
   std::size_t const num_cols = lines[0].size();
-  auto const antenna_map = parse_antenas(lines, num_rows, num_cols);
-  auto const antinode_grid =
-      build_antinode_grid(antenna_map, num_rows, num_cols);
-
-  return count_antinodes(antinode_grid);
+  auto const antenna_index = parse_antenas(lines, num_rows, num_cols);
+  return build_antinode_grid(antenna_index, num_rows, num_cols).count();
 }
 
-std::map<char, std::vector<Antenna>>
+/// classifies every cell in a single pass over the grid, and then groups the
+/// antennas by frequency with a counting sort, keeping them in reading order
+AntennaIndex
 parse_antenas(std::ranges::range auto &&lines,
               std::size_t num_rows,
               std::size_t num_cols) {
-  std::map<char, std::vector<Antenna>> antennas;
+  ASSERT(num_rows <= std::numeric_limits<std::int32_t>::max()
+         && num_cols <= std::numeric_limits<std::int32_t>::max());
+  std::vector<std::uint8_t> frequencies;
+  std::vector<std::int32_t> rows;
+  std::vector<std::int32_t> cols;
+  AntennaIndex index;
   for (std::size_t row{0}; row < num_rows; ++row) {
     for (std::size_t col{0}; col < num_cols; ++col) {
-      if (lines[row][col] == '.') {
+      std::size_t const frequency = frequency_of(lines[row][col]);
+      if (frequency == NO_FREQUENCY) {
         continue;
       }
-      antennas[lines[row][col]].emplace_back(row, col);
+      frequencies.push_back(static_cast<std::uint8_t>(frequency));
+      rows.push_back(static_cast<std::int32_t>(row));
+      cols.push_back(static_cast<std::int32_t>(col));
+      ++index.offsets[frequency + 1];
     }
   }
-  return antennas;
+
+  std::partial_sum(
+      index.offsets.begin(), index.offsets.end(), index.offsets.begin());
+  std::array<std::uint32_t, NUM_FREQUENCIES> next{};
+  std::copy_n(index.offsets.begin(), NUM_FREQUENCIES, next.begin());
+  index.rows.resize(rows.size());
+  index.cols.resize(cols.size());
+  for (std::size_t idx{}; idx < frequencies.size(); ++idx) {
+    std::uint32_t const pos = next[frequencies[idx]]++;
+    index.rows[pos] = rows[idx];
+    index.cols[pos] = cols[idx];
+  }
+  return index;
 }
 
-std::vector<std::vector<bool>>
-build_antinode_grid(std::map<char, std::vector<Antenna>> const &antenna_map,
+/// every frequency is rasterised by its own task into its own grid, and the
+/// grids are or-ed together once all of them are done
+BitMatrix
+build_antinode_grid(AntennaIndex const &index,
                     std::size_t num_rows,
                     std::size_t num_cols) {
-  std::vector<std::vector<bool>> antinode_grid(num_rows,
-                                               std::vector(num_cols, false));
-  for (auto const &[key, antennas] : antenna_map) {
-    std::size_t const num_antennas = antennas.size();
-    for (std::size_t idx1{0}; idx1 < num_antennas - 1; ++idx1) {
-      for (std::size_t idx2{idx1 + 1}; idx2 < num_antennas; ++idx2) {
-        auto const antinodes =
-            antennas[idx1].get_antinodes(antennas[idx2], num_rows, num_cols);
-        for (auto const &antinode : antinodes) {
-          antinode_grid[antinode.m_row][antinode.m_col] = true;
+  std::vector<std::size_t> frequencies;
+  for (std::size_t frequency{}; frequency < NUM_FREQUENCIES; ++frequency) {
+    if (index.size(frequency) > 1) {
+      frequencies.push_back(frequency);
+    }
+  }
+
+  std::vector<BitMatrix> frequency_grids(frequencies.size(),
+                                         BitMatrix(num_rows, num_cols));
+  BS::thread_pool pool;
+  for (std::size_t group{}; group < frequencies.size(); ++group) {
+    pool.detach_task([&index,
+                      frequency = frequencies[group],
+                      &antinodes = frequency_grids[group],
+                      num_rows,
+                      num_cols] {
+      std::size_t const num_antennas = index.size(frequency);
+      for (std::size_t idx1{0}; idx1 < num_antennas; ++idx1) {
+        Location const antenna1 = index.location(frequency, idx1);
+        for (std::size_t idx2{idx1 + 1}; idx2 < num_antennas; ++idx2) {
+          mark_antinodes(antenna1,
+                         index.location(frequency, idx2),
+                         antinodes,
+                         num_rows,
+                         num_cols);
         }
       }
-    }
+    });
+  }
+  pool.wait();
+
+  BitMatrix antinode_grid(num_rows, num_cols);
+  for (auto const &antinodes : frequency_grids) {
+    antinode_grid |= antinodes;
   }
   return antinode_grid;
 }
 
-std::uint64_t
-count_antinodes(std::vector<std::vector<bool>> const &antinode_grid) {
-  std::uint64_t num_antinodes{};
-  for (auto const &line : antinode_grid) {
-    for (auto const &col : line) {
-      if (col) {
-        ++num_antinodes;
-      }
-    }
+/// marks every cell of the grid on the line through both antennas; the step
+/// between the antennas is divided by the gcd of its coordinates, so that no
+/// cell of the line is skipped, and the line is clipped to the grid up front
+/// instead of checking every cell
+void
+mark_antinodes(Location const &antenna1,
+               Location const &antenna2,
+               BitMatrix &antinodes,
+               std::size_t num_rows,
+               std::size_t num_cols) {
+  std::int64_t row_step{antenna2.m_row - antenna1.m_row};
+  std::int64_t col_step{antenna2.m_col - antenna1.m_col};
+  std::int64_t const divisor = std::gcd(row_step, col_step);
+  DEBUG_ASSERT(divisor != 0);
+  row_step /= divisor;
+  col_step /= divisor;
+
+  auto const [row_beg, row_end] =
+      clip(antenna1.m_row, row_step, static_cast<std::int64_t>(num_rows));
+  auto const [col_beg, col_end] =
+      clip(antenna1.m_col, col_step, static_cast<std::int64_t>(num_cols));
+  for (std::int64_t t{std::max(row_beg, col_beg)};
+       t <= std::min(row_end, col_end);
+       ++t) {
+    antinodes.set(static_cast<std::size_t>(antenna1.m_row + (t * row_step)),
+                  static_cast<std::size_t>(antenna1.m_col + (t * col_step)));
+  }
+}
+
+/// the range of `t` for which `pos + t * step` is in `[0, size)`, given that
+/// `pos` itself is in `[0, size)`; `mark_antinodes` relies on this, as it
+/// always starts from an antenna on the grid
+std::pair<std::int64_t, std::int64_t>
+clip(std::int64_t pos, std::int64_t step, std::int64_t size) {
+  if (step > 0) {
+    return {-(pos / step), (size - 1 - pos) / step};
+  }
+  if (step < 0) {
+    return {-((size - 1 - pos) / -step), pos / -step};
   }
-  return num_antinodes;
+  return {std::numeric_limits<std::int64_t>::min(),
+          std::numeric_limits<std::int64_t>::max()};
 }
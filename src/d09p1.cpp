@@ -2,7 +2,6 @@
 #include "libassert/assert.hpp"
 #include <cstdint>
 #include <fstream>
-#include <map>
 #include <ranges>
 #include <string>
 #include <string_view>
@@ -10,18 +9,14 @@
 
 #include "utility.hpp"
 
-static constexpr auto UNINIT = std::numeric_limits<unsigned>::max();
-
 static void
 tests();
 static std::uint64_t
 compute_filesystem_checksum(std::ranges::range auto &&lines);
-static std::vector<unsigned>
-generate_full_disk(std::string_view disk_map);
-static void
-defragment_disk(std::vector<unsigned> &full_disk);
 static std::uint64_t
-compute_disk_checksum(std::vector<unsigned> const &full_disk);
+compact_disk(std::string_view disk_map);
+static std::uint64_t
+run_checksum(std::uint64_t id, std::uint64_t pos, std::uint64_t size);
 
 int
 main(int argc, char const *const *argv) {
@@ -53,62 +48,59 @@ tests() {
   using namespace std::literals::string_view_literals;
   auto lines = std::vector{{"2333133121414131402"sv}};
   ASSERT(compute_filesystem_checksum(lines) == 1928);
+
+  ASSERT(compact_disk("12345") == 60);
+  ASSERT(compact_disk("14113") == 16);
+  ASSERT(compact_disk("1313165") == 69);
+  ASSERT(compact_disk("9953877292941") == 3437);
+  // a disk map that ends with a gap
+  ASSERT(compact_disk("354631466260") == 1003);
+  ASSERT(compact_disk("9") == 0);
 }
 
 std::uint64_t
 compute_filesystem_checksum(std::ranges::range auto &&lines) {
-  auto const &disk_map = lines[0];
-  auto full_disk = generate_full_disk(disk_map);
-  defragment_disk(full_disk);
-  return compute_disk_checksum(full_disk);
+  return compact_disk(lines[0]);
 }
 
-std::vector<unsigned>
-generate_full_disk(std::string_view disk_map) {
-  std::vector<unsigned> full_disk(disk_map.size() * 9, UNINIT);
-  auto disk_it{full_disk.begin()};
-  unsigned file_id{};
-  for (std::size_t idx = 0; idx != disk_map.size(); ++idx) {
-    unsigned block_size = char_to_int(disk_map[idx]);
-    if (idx % 2 == 0) {
-      std::fill_n(disk_it, block_size, file_id);
-      ++file_id;
-    } else {
-      std::fill_n(disk_it, block_size, UNINIT);
+/// fills the gaps from the left with the blocks of the files from the right,
+/// a run of blocks at a time and without expanding the disk map: `right` is
+/// the last file that still has `right_blocks` blocks left to place, and the
+/// blocks of a run are placed next to each other, so their checksum is an
+/// arithmetic series
+std::uint64_t
+compact_disk(std::string_view disk_map) {
+  std::size_t right{(disk_map.size() - 1) / 2 * 2};
+  std::uint64_t right_blocks = char_to_int(disk_map[right]);
+  std::uint64_t pos{};
+  std::uint64_t checksum{};
+  for (std::size_t left{}; left <= right; ++left) {
+    if (left % 2 == 0) {
+      std::uint64_t const size =
+          left == right ? right_blocks : char_to_int(disk_map[left]);
+      checksum += run_checksum(left / 2, pos, size);
+      pos += size;
+      continue;
     }
-    std::advance(disk_it, block_size);
-  }
-  return full_disk;
-}
 
-void
-defragment_disk(std::vector<unsigned> &full_disk) {
-  std::size_t left{0};
-  std::size_t right{full_disk.size() - 1};
-
-  while (left < right) {
-    // advance left until we find an empty space
-    while (left < right && full_disk[left] != UNINIT) {
-      ++left;
+    std::uint64_t gap = char_to_int(disk_map[left]);
+    while (gap != 0 && left < right) {
+      std::uint64_t const moved = std::min(gap, right_blocks);
+      checksum += run_checksum(right / 2, pos, moved);
+      pos += moved;
+      gap -= moved;
+      right_blocks -= moved;
+      if (right_blocks == 0) {
+        right -= 2;
+        right_blocks = char_to_int(disk_map[right]);
+      }
     }
-    // advance right until we find a non-empty space
-    while (left < right && full_disk[right] == UNINIT) {
-      --right;
-    }
-    std::swap(full_disk[left], full_disk[right]);
-    ++left;
-    --right;
   }
+  return checksum;
 }
 
+/// the sum of `pos * id` over a run of `size` blocks of the file `id`
 std::uint64_t
-compute_disk_checksum(std::vector<unsigned> const &full_disk) {
-  std::uint64_t checksum{};
-  for (std::size_t idx{0}; idx < full_disk.size(); ++idx) {
-    if (full_disk[idx] == UNINIT) {
-      break;
-    }
-    checksum += idx * full_disk[idx];
-  }
-  return checksum;
+run_checksum(std::uint64_t id, std::uint64_t pos, std::uint64_t size) {
+  return id * ((pos * size) + (size * (size - 1) / 2));
 }
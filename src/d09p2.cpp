@@ -1,50 +1,80 @@
 #include "fmt/core.h"
 #include "libassert/assert.hpp"
+#include <array>
 #include <cstdint>
 #include <fstream>
+#include <optional>
+#include <queue>
 #include <ranges>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "utility.hpp"
 
-static constexpr auto UNINIT = std::numeric_limits<unsigned>::max();
-
-struct File
+/// a run of blocks of the disk, either a file or a gap between files
+struct Extent
 {
-  bool is_file;
-  std::uint64_t id;
+  std::uint64_t pos;
   std::uint64_t size;
 };
 
+static constexpr std::uint64_t MAX_FILE_SIZE{9};
+
+auto constexpr leftmost_on_top = [](Extent const &lhs, Extent const &rhs) {
+  return lhs.pos > rhs.pos;
+};
+using GapHeap =
+    std::priority_queue<Extent, std::vector<Extent>, decltype(leftmost_on_top)>;
+
+/// the gaps of the disk, in one min-heap on the position per gap size; every
+/// gap of at least `MAX_FILE_SIZE` blocks fits any file, so they all share the
+/// last heap
+class FreeSpace
+{
+private:
+  std::array<GapHeap, MAX_FILE_SIZE + 1> m_heaps;
+
+public:
+  void
+  add(Extent gap) {
+    if (gap.size != 0) {
+      m_heaps[std::min(gap.size, MAX_FILE_SIZE)].push(gap);
+    }
+  }
+
+  /// takes `size` blocks from the leftmost gap that fits them and starts
+  /// before `limit`, and gives the rest of the gap back
+  std::optional<std::uint64_t>
+  allocate(std::uint64_t size, std::uint64_t limit) {
+    GapHeap *best{};
+    for (std::uint64_t gap_size{size}; gap_size <= MAX_FILE_SIZE; ++gap_size) {
+      GapHeap &heap = m_heaps[gap_size];
+      if (!heap.empty() && heap.top().pos < limit
+          && (best == nullptr || heap.top().pos < best->top().pos)) {
+        best = &heap;
+      }
+    }
+    if (best == nullptr) {
+      return std::nullopt;
+    }
+
+    Extent const gap = best->top();
+    best->pop();
+    add({gap.pos + size, gap.size - size});
+    return gap.pos;
+  }
+};
+
 static void
 tests();
 static std::uint64_t
 compute_filesystem_checksum(std::ranges::range auto &&lines);
-static std::vector<File>
-generate_full_disk(std::string_view disk_map);
-static void
-defragment_disk(std::vector<File> &full_disk);
-void
-merge_spaces(std::vector<File> &full_disk);
 static std::uint64_t
-compute_disk_checksum(std::vector<File> const &full_disk);
-
-void
-dump_full_disk(std::vector<File> const &full_disk) {
-  for (File const &f : full_disk) {
-    ASSERT(f.size < 10);
-    for (std::uint64_t idx = 0; idx < f.size; ++idx) {
-      if (f.id == UNINIT) {
-        fmt::print(".");
-      } else {
-        fmt::print("{}", f.id);
-      }
-    }
-  }
-  fmt::println("");
-}
+compact_disk(std::string_view disk_map);
+static std::uint64_t
+extent_checksum(std::uint64_t id, Extent const &file);
 
 int
 main(int argc, char const *const *argv) {
@@ -76,96 +106,59 @@ tests() {
   using namespace std::literals::string_view_literals;
   auto lines = std::vector{{"2333133121414131402"sv}};
   ASSERT(compute_filesystem_checksum(lines) == 2858);
+
+  // the rest of a gap is reused by the next files that fit in it
+  ASSERT(compact_disk("12345") == 132);
+  ASSERT(compact_disk("14113") == 16);
+  ASSERT(compact_disk("1313165") == 169);
+  ASSERT(compact_disk("9953877292941") == 5768);
+  // gaps on both sides of an empty file are a single gap
+  ASSERT(compact_disk("1202041") == 3);
+  ASSERT(compact_disk("1505059") == 135);
 }
 
 std::uint64_t
 compute_filesystem_checksum(std::ranges::range auto &&lines) {
-  auto const &disk_map = lines[0];
-  auto full_disk = generate_full_disk(disk_map);
-  defragment_disk(full_disk);
-  return compute_disk_checksum(full_disk);
+  return compact_disk(lines[0]);
 }
 
-std::vector<File>
-generate_full_disk(std::string_view disk_map) {
-  std::vector<File> full_disk;
-  std::uint64_t file_id{};
+/// every file is moved once, from the highest id down, to the leftmost gap
+/// that fits it; a file only ever moves to the left, into space before all the
+/// files still to move, so the space it frees is never needed again and the
+/// checksum of the file is final as soon as it is placed
+std::uint64_t
+compact_disk(std::string_view disk_map) {
+  std::vector<Extent> files;
+  FreeSpace free_space;
+  Extent gap{};
+  std::uint64_t pos{};
   for (std::size_t idx = 0; idx != disk_map.size(); ++idx) {
-    std::uint64_t block_size = char_to_int(disk_map[idx]);
+    std::uint64_t const size = char_to_int(disk_map[idx]);
     if (idx % 2 == 0) {
-      if (block_size > 0) {
-        full_disk.emplace_back(true, file_id, block_size);
+      files.push_back({pos, size});
+      if (size != 0) {
+        free_space.add(gap);
+        gap = {};
       }
-      ++file_id;
     } else {
-      if (block_size > 0) {
-        full_disk.emplace_back(false, UNINIT, block_size);
-      }
-    }
-  }
-  return full_disk;
-}
-
-void
-defragment_disk(std::vector<File> &full_disk) {
-  std::size_t num_blocks{full_disk.size()};
-  for (std::size_t block_idx{num_blocks - 1}; block_idx != 0; --block_idx) {
-    File &file_block{full_disk[block_idx]};
-    if (!file_block.is_file) {
-      continue;
-    }
-
-    for (std::size_t find_idx{0}; find_idx < block_idx; ++find_idx) {
-      File &space_block{full_disk[find_idx]};
-      if (space_block.is_file) {
-        continue;
-      }
-      if (space_block.size < file_block.size) {
-        continue;
-      }
-
-      std::swap(space_block, file_block);
-      std::uint64_t remaining_space = file_block.size - space_block.size;
-      file_block.size = space_block.size;
-      if (remaining_space != 0) {
-        auto next_it{std::next(full_disk.begin(), find_idx + 1)};
-        full_disk.insert(next_it, File{false, UNINIT, remaining_space});
-        ++block_idx;
-      }
-      merge_spaces(full_disk);
-      break;
+      gap = {gap.size == 0 ? pos : gap.pos, gap.size + size};
     }
+    pos += size;
   }
-}
 
-void
-merge_spaces(std::vector<File> &full_disk) {
-  for (std::size_t idx{}; idx < full_disk.size(); ++idx) {
-    if (full_disk[idx].is_file) {
-      continue;
-    }
-    for (std::size_t sub_idx{idx + 1}; sub_idx < full_disk.size(); ++sub_idx) {
-      if (full_disk[sub_idx].is_file) {
-        break;
-      }
-      full_disk[idx].size += full_disk[sub_idx].size;
-      full_disk.erase(std::next(full_disk.begin(), sub_idx));
-      --sub_idx;
+  std::uint64_t checksum{};
+  for (std::size_t id{files.size()}; id-- > 0;) {
+    Extent file = files[id];
+    if (file.size != 0) {
+      file.pos = free_space.allocate(file.size, file.pos).value_or(file.pos);
     }
+    checksum += extent_checksum(id, file);
   }
+  return checksum;
 }
 
+/// the sum of `pos * id` over the blocks of the file
 std::uint64_t
-compute_disk_checksum(std::vector<File> const &full_disk) {
-  std::uint64_t checksum{};
-  std::size_t disk_idx{};
-  for (File const &f : full_disk) {
-    for (std::size_t idx{0}; idx < f.size; ++idx) {
-      if (f.is_file) {
-        checksum += disk_idx * f.id;
-      }
-      ++disk_idx;
-    }
-  }
-  return checksum;
+extent_checksum(std::uint64_t id, Extent const &file) {
+  return id * ((file.pos * file.size) + (file.size * (file.size - 1) / 2));
 }
@@ -3,41 +3,128 @@
 #include <array>
 #include <cstdint>
 #include <fstream>
+#include <istream>
+#include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_set>
 #include <utility>
+#include <vector>
 
-#include "matrix.hpp"
+#include "BS_thread_pool.hpp"
+#include "utility.hpp"
 
-static constexpr auto UNINIT = std::numeric_limits<unsigned>::max();
+static constexpr unsigned MAX_HEIGHT{9};
+/// the height of the impassable cells, marked with '.'
+static constexpr unsigned NO_HEIGHT{0xF};
 
-enum Dir : std::uint8_t
+/// a trail climbs one step of height per move, so it never leaves the rows
+/// within `MAX_HEIGHT` of its trailhead: the trailheads of a strip of rows only
+/// need that many rows of margin above and below the strip
+static constexpr std::size_t MARGIN_ROWS{MAX_HEIGHT};
+static constexpr std::size_t STRIP_ROWS{128};
+
+/// the cells of every height, as indices into the row-major map
+using Layers = std::array<std::vector<std::uint32_t>, MAX_HEIGHT + 1>;
+
+/// a window of rows of a height map, with two cells per byte; rows are
+/// appended at the bottom as they are read, and dropped from the top once they
+/// are no longer needed
+class HeightMap
 {
-  UP,
-  LEFT,
-  DOWN,
-  RIGHT
+private:
+  std::size_t m_cols{};
+  /// the number of bytes per row
+  std::size_t m_stride{};
+  std::vector<std::uint8_t> m_nibbles;
+
+public:
+  [[nodiscard]] std::size_t
+  rows() const {
+    return m_stride == 0 ? 0 : m_nibbles.size() / m_stride;
+  }
+  [[nodiscard]] std::size_t
+  cols() const {
+    return m_cols;
+  }
+
+  [[nodiscard]] unsigned
+  operator()(std::size_t row, std::size_t col) const {
+    DEBUG_ASSERT(row < rows());
+    DEBUG_ASSERT(col < m_cols);
+    unsigned const byte = m_nibbles[(row * m_stride) + (col / 2)];
+    return col % 2 == 0 ? byte & 0xFU : byte >> 4U;
+  }
+
+  void
+  push_row(std::string_view line) {
+    if (m_stride == 0) {
+      m_cols = line.size();
+      m_stride = (m_cols + 1) / 2;
+    }
+    ASSERT(line.size() == m_cols, line);
+    std::size_t const offset = m_nibbles.size();
+    m_nibbles.resize(offset + m_stride);
+    for (std::size_t col{}; col < m_cols; ++col) {
+      unsigned const height = line[col] == '.' ? NO_HEIGHT
+                                               : char_to_int(line[col]);
+      m_nibbles[offset + (col / 2)] |=
+          static_cast<std::uint8_t>(height << (4 * (col % 2)));
+    }
+  }
+
+  void
+  drop_rows(std::size_t count) {
+    m_nibbles.erase(m_nibbles.begin(),
+                    std::next(m_nibbles.begin(),
+                              static_cast<std::ptrdiff_t>(count * m_stride)));
+  }
 };
 
-static constexpr std::initializer_list<Dir> ALL_DIRS{Dir::UP,
-                                                     Dir::LEFT,
-                                                     Dir::DOWN,
-                                                     Dir::RIGHT};
+/// the summits reachable from the cells of one layer, as sorted summit ids
+/// stored back to back: the summits of the cell at position `pos` in the layer
+/// are `ids[offsets[pos]]` up to `ids[offsets[pos + 1]]`
+struct SummitSets
+{
+  std::vector<std::size_t> offsets;
+  std::vector<std::uint32_t> ids;
+
+  [[nodiscard]] std::span<std::uint32_t const>
+  get(std::size_t pos) const {
+    return std::span(ids).subspan(offsets[pos],
+                                  offsets[pos + 1] - offsets[pos]);
+  }
+};
 
 namespace
 {
 void
 tests();
 std::uint64_t
-sum_of_score_of_trailheads(std::ranges::range auto &&lines);
-Matrix<unsigned>
-generate_grid(std::ranges::range auto &&lines);
+sum_of_score_of_trailheads(std::ranges::input_range auto &&lines);
+std::uint64_t
+sum_of_score_of_trailheads(std::ranges::input_range auto &&lines,
+                           std::size_t strip_rows);
 std::uint64_t
-get_trailhead_score(Matrix<unsigned> const &grid,
-                    std::size_t row,
-                    std::size_t col);
+score_trailheads(HeightMap const &map,
+                std::size_t beg_row,
+                std::size_t end_row,
+                BS::thread_pool &pool);
+SummitSets
+merge_summits(HeightMap const &map,
+              std::vector<std::uint32_t> const &layer,
+              std::vector<std::uint32_t> const &positions,
+              SummitSets const &upper,
+              BS::thread_pool &pool);
+Layers
+group_by_height(HeightMap const &map);
+void
+for_each_uphill(HeightMap const &map,
+                std::uint32_t idx,
+                auto const &fn);
+void
+for_each_chunk(BS::thread_pool &pool, std::size_t size, auto const &fn);
 } // namespace
 
 int
@@ -56,10 +143,9 @@ main(int argc, char const *const *argv) {
     return 2;
   }
 
-  std::vector<std::string> lines;
-  for (std::string line; std::getline(infile, line);) {
-    lines.emplace_back(std::move(line));
-  }
+  // the rows of the map have no blanks, so they can be read as words; the
+  // map is streamed instead of being read up front
+  auto lines = std::views::istream<std::string>(infile);
 
   fmt::println("{}", sum_of_score_of_trailheads(lines));
   return 0;
@@ -127,87 +213,197 @@ tests() {
         "10456732"sv,
     };
     ASSERT(sum_of_score_of_trailheads(lines) == 36);
+    // the trails of every strip run through the margins of the strip
+    for (std::size_t strip_rows{1}; strip_rows <= lines.size(); ++strip_rows) {
+      ASSERT(sum_of_score_of_trailheads(lines, strip_rows) == 36, strip_rows);
+    }
+  }
+  {
+    // 227 trails, but they all end on the same two summits
+    auto const lines = std::array{
+        "012345"sv,
+        "123456"sv,
+        "234567"sv,
+        "345678"sv,
+        "4.6789"sv,
+        "56789."sv,
+    };
+    ASSERT(sum_of_score_of_trailheads(lines) == 2);
+  }
+  {
+    auto const lines = std::array{
+        "0"sv, "1"sv, "2"sv, "3"sv, "4"sv, "5"sv, "6"sv, "7"sv, "8"sv, "9"sv};
+    ASSERT(sum_of_score_of_trailheads(lines, 1) == 1);
+    ASSERT(sum_of_score_of_trailheads(lines | std::views::reverse, 1) == 1);
   }
 }
 
 std::uint64_t
-sum_of_score_of_trailheads(std::ranges::range auto &&lines) {
-  auto grid{generate_grid(lines)};
-  std::uint64_t total_score{};
-  for (std::size_t row = 0; row < grid.rows(); ++row) {
-    for (std::size_t col = 0; col < grid.cols(); ++col) {
-      if (grid(row, col) == 0) {
-        // trailhead
-        total_score += get_trailhead_score(grid, row, col);
-      }
-    }
-  }
-  return total_score;
+sum_of_score_of_trailheads(std::ranges::input_range auto &&lines) {
+  return sum_of_score_of_trailheads(lines, STRIP_ROWS);
 }
 
-Matrix<unsigned>
-generate_grid(std::ranges::range auto &&lines) {
-  Matrix<unsigned> grid(lines.size(), lines[0].size());
-  for (std::size_t line_idx = 0; line_idx < grid.rows(); ++line_idx) {
-    std::ranges::transform(lines[line_idx], grid.get_row(line_idx), [](char ch) {
-      return ch == '.' ? UNINIT : static_cast<unsigned>(ch - '0');
-    });
+/// reads the map in strips of `strip_rows` rows, and only keeps the strip and
+/// its margins in memory: once the margin below a strip has been read, the
+/// trailheads of the strip are scored, and all but the rows of the margin
+/// above the next strip are dropped
+std::uint64_t
+sum_of_score_of_trailheads(std::ranges::input_range auto &&lines,
+                           std::size_t strip_rows) {
+  HeightMap map;
+  // the first row of the current strip; the rows above it are its margin
+  std::size_t strip_beg{};
+  std::uint64_t total{};
+  BS::thread_pool pool;
+
+  for (std::string_view line : lines) {
+    map.push_row(line);
+    if (map.rows() == strip_beg + strip_rows + MARGIN_ROWS) {
+      std::size_t const strip_end = strip_beg + strip_rows;
+      total += score_trailheads(map, strip_beg, strip_end, pool);
+      std::size_t const num_dropped =
+          strip_end - std::min(strip_end, MARGIN_ROWS);
+      map.drop_rows(num_dropped);
+      strip_beg = strip_end - num_dropped;
+    }
   }
-  return grid;
+  return total + score_trailheads(map, strip_beg, map.rows(), pool);
 }
 
+/// the summits reachable from a cell are the union of the summits reachable
+/// from its neighbours one step higher, and every summit only reaches itself
+///
+/// going down the map one height at a time, only the sets of the height above
+/// are kept, and the score of a trailhead is the size of its set; only the
+/// trailheads of the rows `[beg_row, end_row)` are added up, as the trails from
+/// the other rows may leave the window of the map
 std::uint64_t
-get_trailhead_score(Matrix<unsigned> const &grid,
-                    std::size_t head_row,
-                    std::size_t head_col) {
-  std::unordered_set<Location> tails;
+score_trailheads(HeightMap const &map,
+                 std::size_t beg_row,
+                 std::size_t end_row,
+                 BS::thread_pool &pool) {
+  auto const layers = group_by_height(map);
 
-  std::vector<Location> trail;
-  trail.emplace_back(head_row, head_col);
+  std::vector<std::uint32_t> positions(map.rows() * map.cols());
+  for (auto const &layer : layers) {
+    for (std::size_t pos{}; pos < layer.size(); ++pos) {
+      positions[layer[pos]] = static_cast<std::uint32_t>(pos);
+    }
+  }
 
-  while (!trail.empty()) {
-    Location tail = trail.back();
-    trail.pop_back();
+  std::size_t const num_summits = layers[MAX_HEIGHT].size();
+  SummitSets summits{std::vector<std::size_t>(num_summits + 1),
+                     std::vector<std::uint32_t>(num_summits)};
+  std::iota(summits.offsets.begin(), summits.offsets.end(), std::size_t{});
+  std::iota(summits.ids.begin(), summits.ids.end(), std::uint32_t{});
 
-    std::size_t row = tail.row;
-    std::size_t col = tail.col;
+  for (unsigned height{MAX_HEIGHT}; height-- > 0;) {
+    summits = merge_summits(map, layers[height], positions, summits, pool);
+  }
 
-    if (grid(row, col) == 9) {
-      tails.emplace(row, col);
-      continue;
+  std::uint64_t total_score{};
+  for (std::size_t pos{}; pos < layers[0].size(); ++pos) {
+    std::size_t const row = layers[0][pos] / map.cols();
+    if (beg_row <= row && row < end_row) {
+      total_score += summits.get(pos).size();
     }
+  }
+  return total_score;
+}
 
-    for (Dir dir : ALL_DIRS) {
-      switch (dir) {
-      case Dir::UP: {
-        if (row != 0 && grid(row - 1, col) == grid(row, col) + 1) {
-          trail.emplace_back(row - 1, col);
-        }
-        break;
-      }
-      case Dir::LEFT: {
-        if (col != 0 && grid(row, col - 1) == grid(row, col) + 1) {
-          trail.emplace_back(row, col - 1);
-        }
-        break;
-      }
-      case Dir::DOWN: {
-        if (row != grid.rows() - 1 && grid(row + 1, col) == grid(row, col) + 1) {
-          trail.emplace_back(row + 1, col);
-        }
-        break;
-      }
-      case Dir::RIGHT: {
-        if (col != grid.cols() - 1 && grid(row, col + 1) == grid(row, col) + 1) {
-          trail.emplace_back(row, col + 1);
+/// every chunk of the layer merges the sorted sets of the neighbours of its
+/// cells into a buffer of its own, and the buffers are then stitched together
+/// in order
+SummitSets
+merge_summits(HeightMap const &map,
+              std::vector<std::uint32_t> const &layer,
+              std::vector<std::uint32_t> const &positions,
+              SummitSets const &upper,
+              BS::thread_pool &pool) {
+  SummitSets sets{std::vector<std::size_t>(layer.size() + 1), {}};
+  std::vector<std::vector<std::uint32_t>> chunk_ids(pool.get_thread_count());
+
+  for_each_chunk(
+      pool,
+      layer.size(),
+      [&](std::size_t chunk, std::size_t beg, std::size_t end) {
+        std::vector<std::uint32_t> &ids = chunk_ids[chunk];
+        for (std::size_t pos{beg}; pos < end; ++pos) {
+          auto const first = static_cast<std::ptrdiff_t>(ids.size());
+          for_each_uphill(map, layer[pos], [&](std::uint32_t next) {
+            auto const reachable = upper.get(positions[next]);
+            auto const middle = static_cast<std::ptrdiff_t>(ids.size());
+            ids.insert(ids.end(), reachable.begin(), reachable.end());
+            std::inplace_merge(std::next(ids.begin(), first),
+                               std::next(ids.begin(), middle),
+                               ids.end());
+          });
+          ids.erase(std::unique(std::next(ids.begin(), first), ids.end()),
+                    ids.end());
+          sets.offsets[pos + 1] =
+              ids.size() - static_cast<std::size_t>(first);
         }
-        break;
-      }
+      });
+
+  std::partial_sum(
+      sets.offsets.begin(), sets.offsets.end(), sets.offsets.begin());
+  sets.ids.reserve(sets.offsets.back());
+  for (auto const &ids : chunk_ids) {
+    sets.ids.insert(sets.ids.end(), ids.begin(), ids.end());
+  }
+  return sets;
+}
+
+Layers
+group_by_height(HeightMap const &map) {
+  Layers layers;
+  for (std::size_t row = 0; row < map.rows(); ++row) {
+    for (std::size_t col = 0; col < map.cols(); ++col) {
+      if (map(row, col) <= MAX_HEIGHT) {
+        layers[map(row, col)].push_back(
+            static_cast<std::uint32_t>((row * map.cols()) + col));
       }
     }
   }
+  return layers;
+}
 
-  return tails.size();
+/// calls `fn` with the index of every neighbour of the cell `idx` that is
+/// exactly one step higher
+void
+for_each_uphill(HeightMap const &map,
+                std::uint32_t idx,
+                auto const &fn) {
+  auto const cols = static_cast<std::uint32_t>(map.cols());
+  std::size_t const row = idx / cols;
+  std::size_t const col = idx % cols;
+  unsigned const next = map(row, col) + 1;
+  if (row != 0 && map(row - 1, col) == next) {
+    fn(idx - cols);
+  }
+  if (col != 0 && map(row, col - 1) == next) {
+    fn(idx - 1);
+  }
+  if (row != map.rows() - 1 && map(row + 1, col) == next) {
+    fn(idx + cols);
+  }
+  if (col != map.cols() - 1 && map(row, col + 1) == next) {
+    fn(idx + 1);
+  }
+}
+
+/// splits `[0, size)` into one chunk per thread of the pool, and waits for
+/// `fn(chunk, beg, end)` to be done with all of them
+void
+for_each_chunk(BS::thread_pool &pool, std::size_t size, auto const &fn) {
+  std::size_t const num_chunks =
+      std::min<std::size_t>(pool.get_thread_count(), size);
+  for (std::size_t chunk{}; chunk < num_chunks; ++chunk) {
+    pool.detach_task([&fn, chunk, num_chunks, size] {
+      fn(chunk, size * chunk / num_chunks, size * (chunk + 1) / num_chunks);
+    });
+  }
+  pool.wait();
 }
 
 } // namespace
@@ -1,14 +1,22 @@
 #include "fmt/core.h"
 #include "libassert/assert.hpp"
 #include <array>
+#include <chrono>
 #include <cstdint>
 #include <fstream>
-#include <map>
+#include <future>
+#include <istream>
+#include <mutex>
+#include <ostream>
 #include <ranges>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
+#include "BS_thread_pool.hpp"
 #include "matrix.hpp"
 #include "utility.hpp"
 
@@ -18,10 +26,106 @@ namespace
 {
 void
 tests();
+/// the stones that a single stone turns into after one blink; `second` is only
+/// meaningful when `count == 2`
+struct Children
+{
+  std::uint64_t first;
+  std::uint64_t second;
+  std::uint8_t count;
+};
+
+/// the closed set of stones reachable from a seed list, with each stone mapped
+/// to a dense id and the one-blink transitions stored as a sparse matrix (every
+/// row has one or two non-zero entries)
+class StoneEvolution
+{
+private:
+  static constexpr auto NO_CHILD = std::numeric_limits<std::uint32_t>::max();
+
+  std::unordered_map<std::uint64_t, std::uint32_t> m_ids;
+  std::vector<std::array<std::uint32_t, 2>> m_transitions;
+  std::vector<std::uint64_t> m_seed_counts;
+
+  std::uint32_t
+  get_id(std::uint64_t stone, std::vector<std::uint64_t> &frontier);
+
+public:
+  explicit StoneEvolution(std::vector<std::uint64_t> const &seeds);
+
+  [[nodiscard]] std::size_t
+  num_reachable_stones() const {
+    return m_transitions.size();
+  }
+
+  [[nodiscard]] std::uint64_t
+  num_of_stones(std::uint64_t num_blinks) const;
+};
+
+/// a bounded `(stone, num_blinks) -> num_of_stones` memo that can be shared by
+/// many threads; keys are spread over independently locked shards and every
+/// shard evicts with the CLOCK (second chance) policy once it is full
+class BlinkCache
+{
+private:
+  using Key = std::pair<std::uint64_t, std::uint64_t>;
+  static constexpr std::size_t NUM_SHARDS{16};
+  static constexpr std::array<char, 4> MAGIC{'D', '1', '1', 'C'};
+
+  struct Slot
+  {
+    Key key;
+    std::uint64_t value;
+    bool referenced;
+  };
+
+  struct Shard
+  {
+    std::mutex mutex;
+    std::unordered_map<Key, std::size_t> index;
+    std::vector<Slot> slots;
+    std::size_t hand{};
+  };
+
+  std::size_t m_shard_capacity;
+  std::array<Shard, NUM_SHARDS> m_shards;
+
+  Shard &
+  get_shard(Key const &key) {
+    return m_shards[std::hash<Key>{}(key) % NUM_SHARDS];
+  }
+
+public:
+  explicit BlinkCache(std::size_t capacity = 1ULL << 20ULL)
+      : m_shard_capacity(std::max(capacity / NUM_SHARDS, std::size_t{1})) {}
+
+  bool
+  find(std::uint64_t stone, std::uint64_t num_blinks, std::uint64_t &value);
+  void
+  insert(std::uint64_t stone, std::uint64_t num_blinks, std::uint64_t value);
+  [[nodiscard]] std::size_t
+  size();
+
+  /// writes every cached entry as a compact binary stream of
+  /// `(stone, num_blinks, value)` triples, preceded by a magic and a count
+  void
+  save(std::ostream &out);
+  /// merges the entries of a stream produced by `save()` into the cache;
+  /// returns false if the stream is not a valid cache dump
+  bool
+  load(std::istream &in);
+};
+
 std::uint64_t
 num_of_stones(std::ranges::range auto &&lines, std::uint64_t num_blinks);
+std::vector<std::uint64_t>
+num_of_stones_per_line(std::ranges::range auto &&lines,
+                       std::uint64_t num_blinks,
+                       BlinkCache &cache);
 std::uint64_t
-blink(std::uint64_t stone, std::uint64_t num_blinks);
+num_of_stones(std::uint64_t stone, std::uint64_t num_blinks, BlinkCache &cache);
+Children
+blink(std::uint64_t stone);
 } // namespace
 
 int
@@ -66,6 +170,67 @@ tests() {
     };
     ASSERT(num_of_stones(line, 6) == 22);
     ASSERT(num_of_stones(line, 25) == 55312);
+    ASSERT(num_of_stones(line, 75) == 65601038650482);
+  }
+  {
+    StoneEvolution const evolution({0});
+    ASSERT(evolution.num_of_stones(0) == 1);
+    ASSERT(evolution.num_of_stones(4) == 4);
+    // the closed set of stones reachable from 0 is small and finite
+    ASSERT(evolution.num_reachable_stones() == 54);
+  }
+  {
+    auto const lines = std::array{
+        "125 17"sv,
+        "0 1 10 99 999"sv,
+        "17 125"sv,
+    };
+    auto const expected = std::vector<std::uint64_t>{55312, 125681, 55312};
+    // a tiny cache keeps evicting, but must never change the answers
+    for (std::size_t capacity : std::array<std::size_t, 3>{1, 64, 1 << 16}) {
+      BlinkCache cache(capacity);
+      ASSERT(num_of_stones_per_line(lines, 25, cache) == expected);
+      ASSERT(cache.size() <= std::max(capacity, std::size_t{16}));
+    }
+  }
+  {
+    BlinkCache cache;
+    ASSERT(num_of_stones(125, 25, cache) + num_of_stones(17, 25, cache)
+           == 55312);
+    std::stringstream dump;
+    cache.save(dump);
+
+    BlinkCache warm_cache;
+    ASSERT(warm_cache.load(dump));
+    ASSERT(warm_cache.size() == cache.size());
+    std::uint64_t value{};
+    ASSERT(warm_cache.find(125, 25, value));
+    ASSERT(value + num_of_stones(17, 25, warm_cache) == 55312);
+
+    std::stringstream garbage("not a cache");
+    ASSERT(!warm_cache.load(garbage));
+  }
+  {
+    // a dump taken while other threads insert is still a consistent snapshot
+    auto const lines = std::array{"125 17"sv, "0 1 10 99 999"sv, "17 125"sv};
+    BlinkCache cache;
+    BS::thread_pool pool(1);
+    auto counts = pool.submit_task(
+        [&lines, &cache] { return num_of_stones_per_line(lines, 75, cache); });
+    do {
+      std::stringstream dump;
+      cache.save(dump);
+      // a four byte magic and the count, then three u64 per entry
+      std::size_t const num_saved =
+          (dump.str().size() - 4 - sizeof(std::uint64_t))
+          / (3 * sizeof(std::uint64_t));
+
+      BlinkCache warm_cache;
+      ASSERT(warm_cache.load(dump));
+      ASSERT(warm_cache.size() == num_saved);
+    } while (counts.wait_for(std::chrono::seconds(0))
+             != std::future_status::ready);
+    ASSERT(counts.get()[0] == 65601038650482);
   }
 }
 
@@ -74,42 +239,240 @@ num_of_stones(std::ranges::range auto &&lines, std::uint64_t num_blinks) {
   std::vector<std::uint64_t> stones =
       split(lines[0]) | std::views::transform(str_to_int<std::uint64_t>)
       | std::ranges::to<std::vector<std::uint64_t>>();
-  return std::ranges::fold_left(
-      stones,
-      0ULL,
-      [num_blinks](std::uint64_t const &prev, std::uint64_t const &stone) {
-        return prev + blink(stone, num_blinks);
-      });
+  return StoneEvolution(stones).num_of_stones(num_blinks);
 }
 
-std::map<std::pair<std::uint64_t, std::uint64_t>, std::uint64_t> cache;
+/// evaluates every line as an independent list of seeds on the thread pool;
+/// all lines share the same cache, so overlapping sub-results are computed once
+std::vector<std::uint64_t>
+num_of_stones_per_line(std::ranges::range auto &&lines,
+                       std::uint64_t num_blinks,
+                       BlinkCache &cache) {
+  BS::thread_pool pool;
+  std::vector<std::future<std::uint64_t>> futures;
+  futures.reserve(lines.size());
 
-std::uint64_t
-blink(std::uint64_t stone, std::uint64_t num_blinks) {
-  auto key = std::make_pair(stone, num_blinks);
-  auto find_it = cache.find(key);
-  if (find_it != cache.end()) {
-    return find_it->second;
-  }
+  std::ranges::transform(
+      lines,
+      std::back_inserter(futures),
+      [num_blinks, &cache, &pool](auto const &line) {
+        return pool.submit_task([num_blinks, &cache, &line] {
+          return std::ranges::fold_left(
+              split(line),
+              0ULL,
+              [num_blinks, &cache](std::uint64_t prev, std::string_view sv) {
+                return prev
+                       + num_of_stones(str_to_int<std::uint64_t>(sv),
+                                       num_blinks,
+                                       cache);
+              });
+        });
+      });
+
+  std::vector<std::uint64_t> counts;
+  counts.reserve(lines.size());
+  std::ranges::transform(futures,
+                         std::back_inserter(counts),
+                         [](auto &fut) { return fut.get(); });
+  return counts;
+}
 
+std::uint64_t
+num_of_stones(std::uint64_t stone,
+              std::uint64_t num_blinks,
+              BlinkCache &cache) {
   if (num_blinks == 0) {
-    cache[key] = 1;
     return 1;
   }
+  std::uint64_t count{};
+  if (cache.find(stone, num_blinks, count)) {
+    return count;
+  }
+
+  Children children = blink(stone);
+  count = num_of_stones(children.first, num_blinks - 1, cache);
+  if (children.count == 2) {
+    count += num_of_stones(children.second, num_blinks - 1, cache);
+  }
+  cache.insert(stone, num_blinks, count);
+  return count;
+}
+
+Children
+blink(std::uint64_t stone) {
   if (stone == 0) {
-    cache[key] = blink(1, num_blinks - 1);
-    return cache[key];
+    return {1, 0, 1};
   }
-  auto stone_str = std::to_string(stone);
-  auto num_digits = stone_str.size();
+  std::uint8_t num_digits = get_num_digits(stone);
   if (num_digits % 2 == 1) {
-    cache[key] = blink(stone * 2024, num_blinks - 1);
-    return cache[key];
-  }
-  cache[key] = blink(str_to_int<uint64_t>(stone_str.substr(0, num_digits / 2)),
-                     num_blinks - 1)
-               + blink(str_to_int<uint64_t>(stone_str.substr(num_digits / 2)),
-                       num_blinks - 1);
-  return cache[key];
+    return {stone * 2024, 0, 1};
+  }
+  std::uint64_t half = pow10(num_digits / 2);
+  return {stone / half, stone % half, 2};
+}
+
+StoneEvolution::StoneEvolution(std::vector<std::uint64_t> const &seeds) {
+  std::vector<std::uint64_t> frontier;
+  for (std::uint64_t seed : seeds) {
+    std::uint32_t id = get_id(seed, frontier);
+    if (id == m_seed_counts.size()) {
+      m_seed_counts.push_back(0);
+    }
+    ++m_seed_counts[id];
+  }
+
+  // ids are handed out in discovery order, so the transitions of stone `id`
+  // are always filled in when it is popped from the frontier
+  for (std::size_t idx = 0; idx < frontier.size(); ++idx) {
+    Children children = blink(frontier[idx]);
+    std::uint32_t first = get_id(children.first, frontier);
+    std::uint32_t second =
+        children.count == 2 ? get_id(children.second, frontier) : NO_CHILD;
+    m_transitions[idx] = {first, second};
+  }
+  m_seed_counts.resize(m_transitions.size(), 0);
+}
+
+std::uint32_t
+StoneEvolution::get_id(std::uint64_t stone,
+                       std::vector<std::uint64_t> &frontier) {
+  auto [it, inserted] =
+      m_ids.try_emplace(stone, static_cast<std::uint32_t>(m_ids.size()));
+  if (inserted) {
+    frontier.push_back(stone);
+    m_transitions.push_back({NO_CHILD, NO_CHILD});
+  }
+  return it->second;
+}
+
+/// evolves the `id -> count` vector one blink at a time, using the sparse
+/// transition table; the work per blink is bounded by the size of the closed
+/// set, so thousands of blinks are cheap (counts wrap modulo 2^64 once they no
+/// longer fit)
+std::uint64_t
+StoneEvolution::num_of_stones(std::uint64_t num_blinks) const {
+  std::vector<std::uint64_t> counts = m_seed_counts;
+  std::vector<std::uint64_t> next_counts(counts.size());
+  for (std::uint64_t blink_idx = 0; blink_idx < num_blinks; ++blink_idx) {
+    std::ranges::fill(next_counts, 0);
+    for (auto const &[id, count] : std::views::enumerate(counts)) {
+      if (count == 0) {
+        continue;
+      }
+      auto const &[first, second] = m_transitions[static_cast<std::size_t>(id)];
+      next_counts[first] += count;
+      if (second != NO_CHILD) {
+        next_counts[second] += count;
+      }
+    }
+    std::swap(counts, next_counts);
+  }
+  return std::ranges::fold_left(counts, 0ULL, std::plus<>());
+}
+
+bool
+BlinkCache::find(std::uint64_t stone,
+                 std::uint64_t num_blinks,
+                 std::uint64_t &value) {
+  Key key{stone, num_blinks};
+  Shard &shard = get_shard(key);
+  std::scoped_lock lock(shard.mutex);
+  auto find_it = shard.index.find(key);
+  if (find_it == shard.index.end()) {
+    return false;
+  }
+  Slot &slot = shard.slots[find_it->second];
+  slot.referenced = true;
+  value = slot.value;
+  return true;
+}
+
+void
+BlinkCache::insert(std::uint64_t stone,
+                   std::uint64_t num_blinks,
+                   std::uint64_t value) {
+  Key key{stone, num_blinks};
+  Shard &shard = get_shard(key);
+  std::scoped_lock lock(shard.mutex);
+  auto find_it = shard.index.find(key);
+  if (find_it != shard.index.end()) {
+    shard.slots[find_it->second].value = value;
+    return;
+  }
+
+  if (shard.slots.size() < m_shard_capacity) {
+    shard.index.emplace(key, shard.slots.size());
+    shard.slots.push_back({key, value, false});
+    return;
+  }
+
+  // sweep the clock hand, giving every referenced slot a second chance
+  while (shard.slots[shard.hand].referenced) {
+    shard.slots[shard.hand].referenced = false;
+    shard.hand = (shard.hand + 1) % shard.slots.size();
+  }
+  Slot &victim = shard.slots[shard.hand];
+  shard.index.erase(victim.key);
+  shard.index.emplace(key, shard.hand);
+  victim = {key, value, false};
+  shard.hand = (shard.hand + 1) % shard.slots.size();
+}
+
+std::size_t
+BlinkCache::size() {
+  return std::ranges::fold_left(
+      m_shards, 0ULL, [](std::size_t prev, Shard &shard) {
+        std::scoped_lock lock(shard.mutex);
+        return prev + shard.slots.size();
+      });
+}
+
+/// the entries are copied out of every shard under its lock first, so that the
+/// count and the entries written are the same snapshot even while other
+/// threads keep inserting
+void
+BlinkCache::save(std::ostream &out) {
+  auto write_u64 = [&out](std::uint64_t val) {
+    out.write(reinterpret_cast<char const *>(&val), sizeof(val));
+  };
+
+  std::vector<Slot> entries;
+  for (Shard &shard : m_shards) {
+    std::scoped_lock lock(shard.mutex);
+    entries.insert(entries.end(), shard.slots.begin(), shard.slots.end());
+  }
+
+  out.write(MAGIC.data(), MAGIC.size());
+  write_u64(entries.size());
+  for (Slot const &slot : entries) {
+    write_u64(slot.key.first);
+    write_u64(slot.key.second);
+    write_u64(slot.value);
+  }
+}
+
+bool
+BlinkCache::load(std::istream &in) {
+  auto read_u64 = [&in](std::uint64_t &val) {
+    return static_cast<bool>(
+        in.read(reinterpret_cast<char *>(&val), sizeof(val)));
+  };
+
+  std::array<char, MAGIC.size()> magic{};
+  std::uint64_t num_entries{};
+  if (!in.read(magic.data(), magic.size()) || magic != MAGIC
+      || !read_u64(num_entries)) {
+    return false;
+  }
+  for (std::uint64_t entry{}; entry < num_entries; ++entry) {
+    std::uint64_t stone{};
+    std::uint64_t num_blinks{};
+    std::uint64_t value{};
+    if (!read_u64(stone) || !read_u64(num_blinks) || !read_u64(value)) {
+      return false;
+    }
+    insert(stone, num_blinks, value);
+  }
+  return true;
 }
 } // namespace
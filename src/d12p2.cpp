@@ -1,46 +1,155 @@
 #include "fmt/core.h"
 #include "libassert/assert.hpp"
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <fstream>
+#include <numeric>
 #include <ranges>
+#include <span>
 #include <string>
 #include <string_view>
-#include <unordered_set>
+#include <thread>
 #include <utility>
+#include <vector>
 
+#include "BS_thread_pool.hpp"
 #include "matrix.hpp"
 
+/// a maximal stretch `[begin, end)` of plots of the same plant within a row
+struct Run
+{
+  std::uint32_t begin;
+  std::uint32_t end;
+  char plant;
+};
+
+/// the runs of all the rows, stored back to back: the runs of `row` are
+/// `runs[row_offsets[row]]` up to `runs[row_offsets[row + 1]]`
+struct RunRows
+{
+  std::vector<Run> runs;
+  std::vector<std::size_t> row_offsets;
+
+  [[nodiscard]] std::span<Run const>
+  row(std::size_t row) const {
+    return std::span(runs).subspan(row_offsets[row],
+                                   row_offsets[row + 1] - row_offsets[row]);
+  }
+};
+
+struct RegionStats
+{
+  std::uint64_t area;
+  std::uint64_t perimeter;
+  std::uint64_t sides;
+};
+
+/// the fence segments and corners of a region that the sweep found next to
+/// one of its runs, in the row pair above or below the run
+struct RunFences
+{
+  std::uint32_t perimeter;
+  std::uint32_t sides;
+};
+
+/// the runs of a row, with the label and the fences of each run
+struct RowView
+{
+  std::span<Run const> runs;
+  std::span<std::uint32_t const> labels;
+  std::span<RunFences> fences;
+};
+
+/// the label of the plots outside of the garden
+static constexpr std::uint32_t NO_LABEL{~std::uint32_t{}};
+
+/// union-find over the run indices; the representative of a set is always its
+/// smallest index, i.e. the first run of the region in scan order
+///
+/// unions never link runs of different row bands until the seams are merged,
+/// so the bands can be connected concurrently on the same parent array
+class DisjointSets
+{
+private:
+  std::vector<std::uint32_t> m_parent;
+
+public:
+  explicit DisjointSets(std::size_t size) : m_parent(size) {
+    std::iota(m_parent.begin(), m_parent.end(), std::uint32_t{});
+  }
+
+  /// finds the representative, halving the path on the way
+  std::uint32_t
+  find(std::uint32_t idx) {
+    while (m_parent[idx] != idx) {
+      m_parent[idx] = m_parent[m_parent[idx]];
+      idx = m_parent[idx];
+    }
+    return idx;
+  }
+
+  void
+  unite(std::uint32_t lhs, std::uint32_t rhs) {
+    std::uint32_t const root1 = find(lhs);
+    std::uint32_t const root2 = find(rhs);
+    m_parent[std::max(root1, root2)] = std::min(root1, root2);
+  }
+};
+
 namespace
 {
 void
 tests();
 std::uint64_t
 total_cost_of_fence(std::ranges::range auto &&lines);
-Matrix<char>
-generate_augmented_grid(std::ranges::range auto &&lines);
 std::uint64_t
-visit_all_regions(Matrix<char> const &grid);
-std::pair<std::uint64_t, std::uint64_t>
-region_area_and_perimenter(Matrix<char> const &grid,
-                           Matrix<bool> &area_visited,
-                           Location beg_plot);
-bool
-top_left_outer(Matrix<char> const &grid, Location plot);
-bool
-bottom_left_outer(Matrix<char> const &grid, Location plot);
-bool
-top_right_outer(Matrix<char> const &grid, Location plot);
-bool
-bottom_right_outer(Matrix<char> const &grid, Location plot);
-bool
-top_left_inner(Matrix<char> const &grid, Location plot);
-bool
-bottom_left_inner(Matrix<char> const &grid, Location plot);
-bool
-top_right_inner(Matrix<char> const &grid, Location plot);
-bool
-bottom_right_inner(Matrix<char> const &grid, Location plot);
+total_cost_of_fence(std::ranges::range auto &&lines, std::size_t num_bands);
+Matrix<char>
+generate_grid(std::ranges::range auto &&lines);
+std::vector<RegionStats>
+measure_regions(Matrix<char> const &grid, std::size_t num_bands);
+RunRows
+encode_rows(Matrix<char> const &grid,
+            BS::thread_pool &pool,
+            std::size_t num_bands);
+DisjointSets
+connect_runs(RunRows const &run_rows,
+             BS::thread_pool &pool,
+             std::size_t num_bands);
+void
+connect_rows(RunRows const &run_rows, std::size_t row, DisjointSets &sets);
+std::vector<std::uint32_t>
+label_runs(RunRows const &run_rows,
+           DisjointSets &sets,
+           std::vector<RegionStats> &stats);
+void
+measure_boundaries(RunRows const &run_rows,
+                   std::vector<std::uint32_t> const &labels,
+                   std::size_t cols,
+                   BS::thread_pool &pool,
+                   std::size_t num_bands,
+                   std::vector<RegionStats> &stats);
+void
+measure_row_pair(RowView const &upper, RowView const &lower);
+void
+count_corners(std::array<std::uint32_t, 4> const &window,
+              std::array<RunFences *, 4> const &owners);
+
+/// the first row of `band` when `rows` rows are split into `num_bands` bands
+constexpr std::size_t
+band_begin(std::size_t band, std::size_t rows, std::size_t num_bands) {
+  return rows * band / num_bands;
+}
+
+/// the number of corners of a region at the centre of a 2x2 window, indexed by
+/// a mask whose bits 0-3 are set if the top-left, top-right, bottom-left and
+/// bottom-right plots of the window belong to the region
+///
+/// one or three plots make an outer or an inner corner, and two diagonal plots
+/// make two corners; every corner starts a new side
+constexpr std::array<std::uint32_t, 16> CORNERS{
+    0, 1, 1, 0, 1, 0, 2, 1, 1, 2, 0, 1, 0, 1, 1, 0};
 } // namespace
 
 int
@@ -93,6 +202,7 @@ tests() {
     ASSERT(total_cost_of_fence(lines) == 236);
   }
   {
+    // the two B regions only touch diagonally, and so does the inner A
     auto const line = std::array{
         "AAAAAA"sv,
         "AAABBA"sv,
@@ -102,6 +212,9 @@ tests() {
         "AAAAAA"sv,
     };
     ASSERT(total_cost_of_fence(line) == 368);
+    for (std::size_t num_bands{1}; num_bands <= 6; ++num_bands) {
+      ASSERT(total_cost_of_fence(line, num_bands) == 368, num_bands);
+    }
   }
   {
     auto const line = std::array{
@@ -117,173 +230,307 @@ tests() {
         "MMMISSJEEE"sv,
     };
     ASSERT(total_cost_of_fence(line) == 1206);
+    for (std::size_t num_bands{1}; num_bands <= 12; ++num_bands) {
+      ASSERT(total_cost_of_fence(line, num_bands) == 1206, num_bands);
+    }
+  }
+  {
+    // one plot of a window, or all of them but one, always make one corner
+    for (unsigned cell{}; cell < 4; ++cell) {
+      ASSERT(CORNERS[1U << cell] == 1);
+      ASSERT(CORNERS[~(1U << cell) & 0b1111U] == 1);
+    }
+    ASSERT(CORNERS[0b1001] == 2);
+    ASSERT(CORNERS[0b0110] == 2);
+    ASSERT(CORNERS[0b0011] == 0);
+    ASSERT(CORNERS[0b1111] == 0);
   }
 }
 
 std::uint64_t
 total_cost_of_fence(std::ranges::range auto &&lines) {
-  auto grid{generate_augmented_grid(lines)};
-  return visit_all_regions(grid);
+  return total_cost_of_fence(lines, std::thread::hardware_concurrency());
+}
+
+std::uint64_t
+total_cost_of_fence(std::ranges::range auto &&lines, std::size_t num_bands) {
+  return std::ranges::fold_left(
+      measure_regions(generate_grid(lines), num_bands),
+      std::uint64_t{},
+      [](std::uint64_t cost, RegionStats const &region) {
+        return cost + (region.area * region.sides);
+      });
 }
 
 Matrix<char>
-generate_augmented_grid(std::ranges::range auto &&lines) {
-  auto num_rows = lines.size();
-  auto num_cols = lines[0].size();
-  // the grid will have a perimeter of '.', so that we don't have to check that
-  // we are inside the limits
-  Matrix<char> grid(num_rows + 2, num_cols + 2, '.');
-  for (std::size_t row = 0; row < num_rows; ++row) {
-    for (std::size_t col = 0; col < num_cols; ++col) {
-      grid(row + 1, col + 1) = lines[row][col];
-    }
+generate_grid(std::ranges::range auto &&lines) {
+  Matrix<char> grid(lines.size(), lines[0].size());
+  for (std::size_t row = 0; row < grid.rows(); ++row) {
+    std::ranges::copy_n(lines[row].begin(),
+                        static_cast<long>(grid.cols()),
+                        grid.get_row(row));
   }
   return grid;
 }
 
-std::uint64_t
-visit_all_regions(Matrix<char> const &grid) {
-  std::uint64_t total_cost{};
-  Matrix<bool> area_visited{grid.rows(), grid.cols(), false};
-  for (std::size_t row{1}; row < area_visited.rows() - 1; ++row) {
-    for (std::size_t col{1}; col < area_visited.cols() - 1; ++col) {
-      if (area_visited(row, col)) {
-        continue;
+/// two-pass connected component labelling on runs instead of plots:
+///
+/// - every band of rows encodes its rows into runs, and connects the runs of
+///   consecutive rows that overlap and grow the same plant;
+/// - the seams between the bands are then merged, and every run gets the label
+///   of its region, while the areas are summed from the run lengths;
+/// - finally, a single sweep over the runs of consecutive rows finds every
+///   fence segment and every corner of every region
+///
+/// the grid is never flood filled, and past the encoding all the work is per
+/// run rather than per plot
+std::vector<RegionStats>
+measure_regions(Matrix<char> const &grid, std::size_t num_bands) {
+  num_bands = std::clamp<std::size_t>(num_bands, 1, grid.rows());
+  BS::thread_pool pool(num_bands);
+
+  RunRows const run_rows = encode_rows(grid, pool, num_bands);
+  DisjointSets sets = connect_runs(run_rows, pool, num_bands);
+
+  std::vector<RegionStats> stats;
+  auto const labels = label_runs(run_rows, sets, stats);
+  measure_boundaries(run_rows, labels, grid.cols(), pool, num_bands, stats);
+  return stats;
+}
+
+RunRows
+encode_rows(Matrix<char> const &grid,
+            BS::thread_pool &pool,
+            std::size_t num_bands) {
+  RunRows run_rows{{}, std::vector<std::size_t>(grid.rows() + 1)};
+  std::vector<std::vector<Run>> band_runs(num_bands);
+  for (std::size_t band{}; band < num_bands; ++band) {
+    pool.detach_task([&grid, &run_rows, &band_runs, band, num_bands] {
+      auto const cols = static_cast<std::uint32_t>(grid.cols());
+      std::size_t const end_row = band_begin(band + 1, grid.rows(), num_bands);
+      for (std::size_t row{band_begin(band, grid.rows(), num_bands)};
+           row < end_row;
+           ++row) {
+        char const *plants = grid.get_row(row);
+        std::size_t const num_runs = band_runs[band].size();
+        for (std::uint32_t begin{}; begin < cols;) {
+          std::uint32_t end{begin + 1};
+          while (end < cols && plants[end] == plants[begin]) {
+            ++end;
+          }
+          band_runs[band].push_back({begin, end, plants[begin]});
+          begin = end;
+        }
+        run_rows.row_offsets[row + 1] = band_runs[band].size() - num_runs;
       }
-      auto [area, perimeter] =
-          region_area_and_perimenter(grid, area_visited, Location{row, col});
-      total_cost += area * perimeter;
-    }
+    });
   }
-  return total_cost;
-}
+  pool.wait();
 
-std::pair<std::uint64_t, std::uint64_t>
-region_area_and_perimenter(Matrix<char> const &grid,
-                           Matrix<bool> &area_visited,
-                           Location beg_plot) {
-  std::uint64_t area{};
-  std::uint64_t perimeter{};
+  std::partial_sum(run_rows.row_offsets.begin(),
+                   run_rows.row_offsets.end(),
+                   run_rows.row_offsets.begin());
+  run_rows.runs.resize(run_rows.row_offsets.back());
+  for (std::size_t band{}; band < num_bands; ++band) {
+    std::size_t const offset =
+        run_rows.row_offsets[band_begin(band, grid.rows(), num_bands)];
+    std::ranges::copy(band_runs[band],
+                      std::next(run_rows.runs.begin(),
+                                static_cast<std::ptrdiff_t>(offset)));
+  }
+  return run_rows;
+}
 
-  std::unordered_set<Location> to_visit;
-  to_visit.emplace(beg_plot);
+DisjointSets
+connect_runs(RunRows const &run_rows,
+             BS::thread_pool &pool,
+             std::size_t num_bands) {
+  std::size_t const rows = run_rows.row_offsets.size() - 1;
+  DisjointSets sets(run_rows.runs.size());
+  for (std::size_t band{}; band < num_bands; ++band) {
+    pool.detach_task([&run_rows, &sets, band, rows, num_bands] {
+      std::size_t const end_row = band_begin(band + 1, rows, num_bands);
+      for (std::size_t row{band_begin(band, rows, num_bands) + 1};
+           row < end_row;
+           ++row) {
+        connect_rows(run_rows, row, sets);
+      }
+    });
+  }
+  pool.wait();
 
-  while (!to_visit.empty()) {
-    auto it = to_visit.begin();
-    auto plot = *it;
-    auto [row, col] = plot;
-    to_visit.erase(it);
+  for (std::size_t band{1}; band < num_bands; ++band) {
+    connect_rows(run_rows, band_begin(band, rows, num_bands), sets);
+  }
+  return sets;
+}
 
-    area_visited(row, col) = true;
-    ++area;
+/// connects the runs of `row` to the runs of the row above, merging the two
+/// sorted lists of runs and uniting every overlapping pair of the same plant
+void
+connect_rows(RunRows const &run_rows, std::size_t row, DisjointSets &sets) {
+  auto const upper = run_rows.row(row - 1);
+  auto const lower = run_rows.row(row);
+  auto const upper_offset =
+      static_cast<std::uint32_t>(run_rows.row_offsets[row - 1]);
+  auto const lower_offset =
+      static_cast<std::uint32_t>(run_rows.row_offsets[row]);
 
-    if (top_left_outer(grid, plot)) {
-      ++perimeter;
-    }
-    if (top_right_outer(grid, plot)) {
-      ++perimeter;
-    }
-    if (bottom_left_outer(grid, plot)) {
-      ++perimeter;
-    }
-    if (bottom_right_outer(grid, plot)) {
-      ++perimeter;
-    }
-    if (top_left_inner(grid, plot)) {
-      ++perimeter;
-    }
-    if (top_right_inner(grid, plot)) {
-      ++perimeter;
-    }
-    if (bottom_left_inner(grid, plot)) {
-      ++perimeter;
-    }
-    if (bottom_right_inner(grid, plot)) {
-      ++perimeter;
+  std::uint32_t up{};
+  std::uint32_t down{};
+  while (up < upper.size() && down < lower.size()) {
+    if (upper[up].plant == lower[down].plant) {
+      sets.unite(upper_offset + up, lower_offset + down);
     }
+    std::uint32_t const upper_end = upper[up].end;
+    std::uint32_t const lower_end = lower[down].end;
+    up += upper_end <= lower_end ? 1 : 0;
+    down += lower_end <= upper_end ? 1 : 0;
+  }
+}
 
-    // UP
-    if (row != 0 && grid(row - 1, col) == grid(row, col)
-        && !area_visited(row - 1, col)) {
-      to_visit.emplace(row - 1, col);
-    }
-    // LEFT
-    if (col != 0 && grid(row, col - 1) == grid(row, col)
-        && !area_visited(row, col - 1)) {
-      to_visit.emplace(row, col - 1);
-    }
-    // DOWN
-    if (row != grid.rows() - 1 && grid(row + 1, col) == grid(row, col)
-        && !area_visited(row + 1, col)) {
-      to_visit.emplace(row + 1, col);
-    }
-    // RIGHT
-    if (col != grid.cols() - 1 && grid(row, col + 1) == grid(row, col)
-        && !area_visited(row, col + 1)) {
-      to_visit.emplace(row, col + 1);
+/// the representative of a region is its first run in scan order, so it is
+/// always labelled before any of the other runs of its region
+///
+/// the runs next to a run in the same row grow other plants, so every run also
+/// adds the fence segments at both of its ends
+std::vector<std::uint32_t>
+label_runs(RunRows const &run_rows,
+           DisjointSets &sets,
+           std::vector<RegionStats> &stats) {
+  std::vector<std::uint32_t> labels(run_rows.runs.size());
+  for (std::uint32_t idx{}; idx < labels.size(); ++idx) {
+    std::uint32_t const root = sets.find(idx);
+    if (root == idx) {
+      labels[idx] = static_cast<std::uint32_t>(stats.size());
+      stats.push_back({});
+    } else {
+      labels[idx] = labels[root];
     }
+    Run const &run = run_rows.runs[idx];
+    stats[labels[idx]].area += run.end - run.begin;
+    stats[labels[idx]].perimeter += 2;
   }
-
-  return {area, perimeter};
+  return labels;
 }
 
-bool
-top_left_outer(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col - 1) != p && grid(row - 1, col) != p;
-}
+/// sweeps every pair of consecutive rows, including the pairs with the rows
+/// just outside of the garden, and then adds up the fences of every run into
+/// the stats of its region
+///
+/// the rows are split into bands again; a band only writes to the fences below
+/// the upper rows and above the lower rows of its row pairs, so the bands never
+/// share a counter, even on the rows at their seams
+void
+measure_boundaries(RunRows const &run_rows,
+                   std::vector<std::uint32_t> const &labels,
+                   std::size_t cols,
+                   BS::thread_pool &pool,
+                   std::size_t num_bands,
+                   std::vector<RegionStats> &stats) {
+  std::size_t const rows = run_rows.row_offsets.size() - 1;
+  std::vector<RunFences> fences_above(run_rows.runs.size());
+  std::vector<RunFences> fences_below(run_rows.runs.size());
 
-bool
-bottom_left_outer(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col - 1) != p && grid(row + 1, col) != p;
-}
+  for (std::size_t band{}; band < num_bands; ++band) {
+    pool.detach_task([&, band] {
+      // the rows just outside of the garden are a single run without a label
+      std::array const outside_runs{
+          Run{0, static_cast<std::uint32_t>(cols), 0}};
+      std::array const outside_labels{NO_LABEL};
+      std::array<RunFences, 1> outside_fences{};
+      auto const view_row = [&](std::size_t row,
+                                std::vector<RunFences> &fences) {
+        if (row >= rows) {
+          return RowView{outside_runs, outside_labels, outside_fences};
+        }
+        auto const runs = run_rows.row(row);
+        std::size_t const offset = run_rows.row_offsets[row];
+        return RowView{runs,
+                       std::span(labels).subspan(offset, runs.size()),
+                       std::span(fences).subspan(offset, runs.size())};
+      };
 
-bool
-top_right_outer(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col + 1) != p && grid(row - 1, col) != p;
-}
+      // the last band also sweeps the row pair below the garden
+      std::size_t const beg_row = band_begin(band, rows, num_bands);
+      std::size_t const end_row = band + 1 == num_bands
+                                      ? rows + 1
+                                      : band_begin(band + 1, rows, num_bands);
+      for (std::size_t row{beg_row}; row < end_row; ++row) {
+        measure_row_pair(view_row(row == 0 ? rows : row - 1, fences_below),
+                         view_row(row, fences_above));
+      }
+    });
+  }
+  pool.wait();
 
-bool
-bottom_right_outer(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col + 1) != p && grid(row + 1, col) != p;
+  for (std::size_t idx{}; idx < labels.size(); ++idx) {
+    RegionStats &region = stats[labels[idx]];
+    region.perimeter += fences_above[idx].perimeter;
+    region.perimeter += fences_below[idx].perimeter;
+    region.sides += fences_above[idx].sides + fences_below[idx].sides;
+  }
 }
 
-bool
-top_left_inner(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col + 1) == p && grid(row + 1, col) == p
-         && grid(row + 1, col + 1) != p;
-}
+/// walks the overlapping stretches of the runs of two consecutive rows:
+///
+/// - every stretch where the two rows belong to different regions is fenced
+///   along its whole length;
+/// - a corner can only be where a new run starts in either row, or at the end
+///   of the rows, so the 2x2 window is only looked at there
+void
+measure_row_pair(RowView const &upper, RowView const &lower) {
+  RunFences outside{};
+  std::array window{NO_LABEL, NO_LABEL, NO_LABEL, NO_LABEL};
+  std::array owners{&outside, &outside, &outside, &outside};
 
-bool
-bottom_left_inner(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col + 1) == p && grid(row - 1, col) == p
-         && grid(row - 1, col + 1) != p;
-}
+  std::size_t up{};
+  std::size_t down{};
+  while (up < upper.runs.size() && down < lower.runs.size()) {
+    window = {window[1], upper.labels[up], window[3], lower.labels[down]};
+    owners = {owners[1], &upper.fences[up], owners[3], &lower.fences[down]};
+    count_corners(window, owners);
 
-bool
-top_right_inner(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col - 1) == p && grid(row + 1, col) == p
-         && grid(row + 1, col - 1) != p;
+    std::uint32_t const beg =
+        std::max(upper.runs[up].begin, lower.runs[down].begin);
+    std::uint32_t const end =
+        std::min(upper.runs[up].end, lower.runs[down].end);
+    if (window[1] != window[3]) {
+      upper.fences[up].perimeter += end - beg;
+      lower.fences[down].perimeter += end - beg;
+    }
+
+    up += upper.runs[up].end == end ? 1U : 0U;
+    down += lower.runs[down].end == end ? 1U : 0U;
+  }
+  window = {window[1], NO_LABEL, window[3], NO_LABEL};
+  owners = {owners[1], &outside, owners[3], &outside};
+  count_corners(window, owners);
 }
 
-bool
-bottom_right_inner(Matrix<char> const &grid, Location plot) {
-  auto [row, col] = plot;
-  auto p = grid(row, col);
-  return grid(row, col - 1) == p && grid(row - 1, col) == p
-         && grid(row - 1, col - 1) != p;
+/// adds the corners in the window `{top-left, top-right, bottom-left,
+/// bottom-right}` to the first run of each region in the window
+///
+/// the six pairwise comparisons give the mask of every plot's region, and a
+/// plot that belongs to the same region as an earlier plot adds nothing, so
+/// the window is counted without any branches; the plots outside of the garden
+/// are counted too, into a run that is thrown away
+void
+count_corners(std::array<std::uint32_t, 4> const &window,
+              std::array<RunFences *, 4> const &owners) {
+  unsigned const eq01 = window[0] == window[1] ? 1U : 0U;
+  unsigned const eq02 = window[0] == window[2] ? 1U : 0U;
+  unsigned const eq03 = window[0] == window[3] ? 1U : 0U;
+  unsigned const eq12 = window[1] == window[2] ? 1U : 0U;
+  unsigned const eq13 = window[1] == window[3] ? 1U : 0U;
+  unsigned const eq23 = window[2] == window[3] ? 1U : 0U;
+
+  owners[0]->sides += CORNERS[0b0001 | eq01 << 1 | eq02 << 2 | eq03 << 3];
+  owners[1]->sides +=
+      CORNERS[eq01 | 0b0010 | eq12 << 2 | eq13 << 3] * (eq01 ^ 1U);
+  owners[2]->sides +=
+      CORNERS[eq02 | eq12 << 1 | 0b0100 | eq23 << 3] * ((eq02 | eq12) ^ 1U);
+  owners[3]->sides += CORNERS[eq03 | eq13 << 1 | eq23 << 2 | 0b1000]
+                      * ((eq03 | eq13 | eq23) ^ 1U);
 }
 } // namespace
@@ -1,18 +1,18 @@
+#include <algorithm>
 #include <array>
+#include <cmath>
 #include <cstdint>
 #include <fmt/core.h>
 #include <fstream>
 #include <libassert/assert.hpp>
-#include <queue>
+#include <optional>
 #include <ranges>
-#include <scn/scan.h>
 #include <string>
 #include <string_view>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
-#include "matrix.hpp"
-#include "utility.hpp"
+#include "utility.hpp" // int128_t, uint128_t, is_digit
 
 struct Button
 {
@@ -29,16 +29,62 @@ struct Game
   std::uint64_t prize_y;
 };
 
+static constexpr std::uint64_t COST_A{3};
+static constexpr std::uint64_t COST_B{1};
+
+/// the games as one array per field, so that the batch solve is a plain loop
+/// over lanes
+struct Games
+{
+  std::vector<std::uint64_t> sax;
+  std::vector<std::uint64_t> say;
+  std::vector<std::uint64_t> sbx;
+  std::vector<std::uint64_t> sby;
+  std::vector<std::uint64_t> prize_x;
+  std::vector<std::uint64_t> prize_y;
+
+  [[nodiscard]] std::size_t
+  size() const {
+    return sax.size();
+  }
+  [[nodiscard]] Game
+  game(std::size_t idx) const {
+    return {Button{sax[idx], say[idx], COST_A},
+            Button{sbx[idx], sby[idx], COST_B},
+            prize_x[idx],
+            prize_y[idx]};
+  }
+};
+
+/// a double holds every integer up to 2^53 exactly; if all the terms of
+/// Cramer's rule stay below this bound, the quotients computed in double are
+/// the exact solution whenever there is an integer one
+static constexpr double EXACT_DOUBLE_BOUND{0x1p52};
+
 namespace
 {
 void
 tests();
 std::uint64_t
 min_num_tokens(std::ranges::range auto &&lines);
-std::vector<Game>
-generate_games(std::ranges::range auto &&lines);
+Games
+parse_games(std::ranges::range auto &&lines);
+std::pair<std::uint64_t, std::uint64_t>
+scan_two_numbers(std::string_view line);
+std::uint64_t
+min_num_tokens(Games const &games);
 std::uint64_t
 min_num_tokens(Game const &game);
+std::optional<std::pair<int128_t, int128_t>>
+solve_collinear(int128_t step_a,
+                int128_t step_b,
+                int128_t target,
+                int128_t cost_a,
+                int128_t cost_b);
+int128_t
+floor_div(int128_t num, int128_t den);
+int128_t
+ceil_div(int128_t num, int128_t den);
 } // namespace
 
 int
@@ -123,94 +169,271 @@ tests() {
     };
     ASSERT(min_num_tokens(line) == 480);
   }
+  {
+    // collinear buttons have many solutions, and the cheapest one wins
+    ASSERT(min_num_tokens(Game{{2, 4, 3}, {3, 6, 1}, 12, 24}) == 4);
+    ASSERT(min_num_tokens(Game{{3, 3, 3}, {2, 2, 1}, 7, 7}) == 5);
+    ASSERT(min_num_tokens(Game{{9, 9, 3}, {2, 2, 1}, 36, 36}) == 12);
+    // off the line of the buttons, or between its reachable points
+    ASSERT(min_num_tokens(Game{{1, 2, 3}, {2, 4, 1}, 3, 5}) == 0);
+    ASSERT(min_num_tokens(Game{{2, 2, 3}, {4, 4, 1}, 5, 5}) == 0);
+    // a button that only moves along one axis
+    ASSERT(min_num_tokens(Game{{6, 3, 3}, {1, 0, 1}, 20, 9}) == 11);
+  }
+  {
+    // products of these prizes and steps overflow 64 bits
+    auto const lines = std::array{
+        "Button A: X+1000003, Y+999983"sv,
+        "Button B: X+999979, Y+1000033"sv,
+        "Prize: X=3999940000000000000, Y=4000082000000000000"sv,
+    };
+    ASSERT(min_num_tokens(lines) == 6000000000000);
+  }
+  {
+    auto [step_x, step_y] = scan_two_numbers("Button A: X+94, Y+34");
+    ASSERT(step_x == 94 && step_y == 34);
+    auto [prize_x, prize_y] =
+        scan_two_numbers("Prize: X=0, Y=18446744073709551615");
+    ASSERT(prize_x == 0 && prize_y == ~std::uint64_t{});
+  }
+  {
+    // the batch must agree with the exact solver on every kind of game: the
+    // estimates are only trusted where they are exact
+    std::vector<Game> const cases{
+        {{94, 34, COST_A}, {22, 67, COST_B}, 8400, 5400},
+        {{26, 66, COST_A}, {67, 21, COST_B}, 12748, 12176},
+        {{2, 4, COST_A}, {3, 6, COST_B}, 12, 24},
+        {{9, 9, COST_A}, {2, 2, COST_B}, 36, 36},
+        {{6, 3, COST_A}, {1, 0, COST_B}, 20, 9},
+        {{1000003, 999983, COST_A},
+         {999979, 1000033, COST_B},
+         3999940000000000000,
+         4000082000000000000},
+        {{1, 1, COST_A}, {1, 2, COST_B}, 9007199254740993, 9007199254740993},
+    };
+    Games games;
+    std::uint64_t expected{};
+    for (Game const &game : cases) {
+      games.sax.push_back(game.button_A.step_x);
+      games.say.push_back(game.button_A.step_y);
+      games.sbx.push_back(game.button_B.step_x);
+      games.sby.push_back(game.button_B.step_y);
+      games.prize_x.push_back(game.prize_x);
+      games.prize_y.push_back(game.prize_y);
+      expected += min_num_tokens(game);
+    }
+    ASSERT(expected == 280 + 4 + 12 + 11 + 6000000000000 + 27021597764222979);
+    ASSERT(min_num_tokens(games) == expected);
+  }
 }
 
 std::uint64_t
 min_num_tokens(std::ranges::range auto &&lines) {
-  auto games{generate_games(lines)};
-  return std::ranges::fold_left(games,
-                                0ULL,
-                                [](std::uint64_t prev, Game const &game) {
-                                  return prev + min_num_tokens(game);
-                                });
+  return min_num_tokens(parse_games(lines));
 }
-std::vector<Game>
-generate_games(std::ranges::range auto &&lines) {
-  std::vector<Game> games;
-  std::size_t line_idx{};
-  while (line_idx < lines.size()) {
-    if (line_idx != 0) {
-      ASSERT(lines[line_idx++] == "");
-    }
 
-    auto [step_x_A, step_y_A] =
-        scn::scan<std::uint64_t, std::uint64_t>(lines[line_idx++],
-                                                "Button A: X+{}, Y+{}")
-            ->values();
-    auto [step_x_B, step_y_B] =
-        scn::scan<std::uint64_t, std::uint64_t>(lines[line_idx++],
-                                                "Button B: X+{}, Y+{}")
-            ->values();
-    auto [prize_x, prize_y] =
-        scn::scan<std::uint64_t, std::uint64_t>(lines[line_idx++],
-                                                "Prize: X={}, Y={}")
-            ->values();
-    games.emplace_back(Button{step_x_A, step_y_A, 3},
-                       Button{step_x_B, step_y_B, 1},
-                       prize_x,
-                       prize_y);
+Games
+parse_games(std::ranges::range auto &&lines) {
+  Games games;
+  for (std::size_t line_idx{}; line_idx < lines.size(); line_idx += 4) {
+    ASSERT(line_idx + 2 < lines.size());
+    auto [sax, say] = scan_two_numbers(lines[line_idx]);
+    auto [sbx, sby] = scan_two_numbers(lines[line_idx + 1]);
+    auto [prize_x, prize_y] = scan_two_numbers(lines[line_idx + 2]);
+    ASSERT(line_idx + 3 >= lines.size() || lines[line_idx + 3] == "");
+    games.sax.push_back(sax);
+    games.say.push_back(say);
+    games.sbx.push_back(sbx);
+    games.sby.push_back(sby);
+    games.prize_x.push_back(prize_x);
+    games.prize_y.push_back(prize_y);
   }
   return games;
 }
 
+/// the two numbers of a line such as "Button A: X+94, Y+34"; every line of
+/// the input holds exactly two unsigned numbers and nothing else that looks
+/// like one, so a single pass over the digits replaces a format-driven scan
+std::pair<std::uint64_t, std::uint64_t>
+scan_two_numbers(std::string_view line) {
+  std::array<std::uint64_t, 2> nums{};
+  std::size_t num_idx{};
+  bool in_number{};
+  for (char ch : line) {
+    if (is_digit(ch)) {
+      ASSERT(num_idx < nums.size(), line);
+      nums[num_idx] = (nums[num_idx] * 10) + char_to_int(ch);
+      in_number = true;
+    } else if (in_number) {
+      ++num_idx;
+      in_number = false;
+    }
+  }
+  num_idx += in_number ? 1 : 0;
+  ASSERT(num_idx == nums.size(), line);
+  return {nums[0], nums[1]};
+}
+
+/// the batch solve runs in two passes: the first estimates every solution in
+/// double precision, with no branches and no integer division, so that the
+/// compiler can run it over SIMD lanes; the second verifies the estimates in
+/// exact integer arithmetic, and only hands the games whose estimates can't be
+/// trusted, collinear buttons or huge values, to the exact solver
+std::uint64_t
+min_num_tokens(Games const &games) {
+  std::size_t const num_games = games.size();
+  std::vector<double> estimates_a(num_games);
+  std::vector<double> estimates_b(num_games);
+  std::vector<std::uint8_t> is_exact(num_games);
+  for (std::size_t idx{}; idx < num_games; ++idx) {
+    auto const sax = static_cast<double>(games.sax[idx]);
+    auto const say = static_cast<double>(games.say[idx]);
+    auto const sbx = static_cast<double>(games.sbx[idx]);
+    auto const sby = static_cast<double>(games.sby[idx]);
+    auto const X = static_cast<double>(games.prize_x[idx]);
+    auto const Y = static_cast<double>(games.prize_y[idx]);
+
+    double const det = (sax * sby) - (sbx * say);
+    estimates_a[idx] = std::round(((X * sby) - (Y * sbx)) / det);
+    estimates_b[idx] = std::round(((Y * sax) - (X * say)) / det);
+    double const largest = std::max(
+        {X, Y, X * sby, Y * sbx, Y * sax, X * say, sax * sby, sbx * say});
+    is_exact[idx] = static_cast<std::uint8_t>(det != 0.0
+                                              && largest < EXACT_DOUBLE_BOUND);
+  }
+
+  std::uint64_t total{};
+  for (std::size_t idx{}; idx < num_games; ++idx) {
+    if (is_exact[idx] == 0) {
+      total += min_num_tokens(games.game(idx));
+      continue;
+    }
+    // an exact estimate is the solution if there is one, so a failed check
+    // means that the prize can't be won
+    if (estimates_a[idx] < 0.0 || estimates_b[idx] < 0.0) {
+      continue;
+    }
+    auto const num_a = static_cast<std::uint64_t>(estimates_a[idx]);
+    auto const num_b = static_cast<std::uint64_t>(estimates_b[idx]);
+    auto reached = [num_a, num_b](std::uint64_t step_a, std::uint64_t step_b) {
+      return (uint128_t{num_a} * step_a) + (uint128_t{num_b} * step_b);
+    };
+    if (reached(games.sax[idx], games.sbx[idx]) == games.prize_x[idx]
+        && reached(games.say[idx], games.sby[idx]) == games.prize_y[idx]) {
+      total += (num_a * COST_A) + (num_b * COST_B);
+    }
+  }
+  return total;
+}
+
+/// the number of presses (a, b) solves
+///   a * sax + b * sbx = X
+///   a * say + b * sby = Y
+/// over the non-negative integers; every intermediate is kept in signed 128
+/// bits, so that products of large prizes and large steps can't overflow
+///
+/// if the buttons are not collinear the solution is unique, by Cramer's rule;
+/// otherwise every solution of the x equation also solves the y one, as long
+/// as one of them does, and the cheapest is found among all of them
 std::uint64_t
 min_num_tokens(Game const &game) {
-  std::unordered_map<Location, std::uint64_t> position_cost;
-  position_cost.emplace(std::piecewise_construct,
-                        std::forward_as_tuple(game.prize_y, game.prize_x),
-                        std::forward_as_tuple(0));
-
-  std::queue<Location> positions;
-  positions.emplace(game.prize_y, game.prize_x);
-  while (!positions.empty()) {
-    auto top = positions.front();
-    positions.pop();
-
-    auto top_it = position_cost.find(top);
-
-    if (top.col >= game.button_A.step_x && top.row >= game.button_A.step_y) {
-      Location next_pos{top.row - game.button_A.step_y,
-                        top.col - game.button_A.step_x};
-      auto next_it = position_cost.find(next_pos);
-      auto next_cost = top_it->second + game.button_A.cost;
-      if (next_it == position_cost.end()) {
-        positions.emplace(next_pos);
-        position_cost.emplace(next_pos, next_cost);
-      } else if (next_it->second > next_cost) {
-        positions.emplace(next_pos);
-        next_it->second = next_cost;
-      }
+  int128_t const sax{game.button_A.step_x};
+  int128_t const say{game.button_A.step_y};
+  int128_t const sbx{game.button_B.step_x};
+  int128_t const sby{game.button_B.step_y};
+  int128_t const X{game.prize_x};
+  int128_t const Y{game.prize_y};
+  int128_t const cost_a{game.button_A.cost};
+  int128_t const cost_b{game.button_B.cost};
+
+  std::optional<std::pair<int128_t, int128_t>> presses;
+  int128_t const det = (sax * sby) - (sbx * say);
+  if (det != 0) {
+    int128_t const num_a = (X * sby) - (Y * sbx);
+    int128_t const num_b = (Y * sax) - (X * say);
+    if (num_a % det == 0 && num_b % det == 0) {
+      presses.emplace(num_a / det, num_b / det);
     }
-    if (top.col >= game.button_B.step_x && top.row >= game.button_B.step_y) {
-      Location next_pos{top.row - game.button_B.step_y,
-                        top.col - game.button_B.step_x};
-      auto next_it = position_cost.find(next_pos);
-      auto next_cost = top_it->second + game.button_B.cost;
-      if (next_it == position_cost.end()) {
-        positions.emplace(next_pos);
-        position_cost.emplace(next_pos, next_cost);
-      } else if (next_it->second > next_cost) {
-        positions.emplace(next_pos);
-        next_it->second = next_cost;
-      }
+  } else if (sax != 0 || sbx != 0) {
+    presses = solve_collinear(sax, sbx, X, cost_a, cost_b);
+  } else {
+    presses = solve_collinear(say, sby, Y, cost_a, cost_b);
+  }
+
+  if (!presses) {
+    return 0;
+  }
+  auto [num_a, num_b] = *presses;
+  if (num_a < 0 || num_b < 0 || (num_a * sax) + (num_b * sbx) != X
+      || (num_a * say) + (num_b * sby) != Y) {
+    return 0;
+  }
+  return static_cast<std::uint64_t>((num_a * cost_a) + (num_b * cost_b));
+}
+
+/// the cheapest non-negative (a, b) with a * step_a + b * step_b = target;
+/// with g = gcd(step_a, step_b) and one solution (a0, b0) from the extended
+/// euclidean algorithm, all the solutions are
+///   (a0 + t * step_b / g, b0 - t * step_a / g)
+/// and the cost is linear in t, so the cheapest is at one end of the range of
+/// t that keeps both counts non-negative
+std::optional<std::pair<int128_t, int128_t>>
+solve_collinear(int128_t step_a,
+                int128_t step_b,
+                int128_t target,
+                int128_t cost_a,
+                int128_t cost_b) {
+  if (step_a == 0 && step_b == 0) {
+    return target == 0 ? std::optional{std::pair<int128_t, int128_t>{}}
+                       : std::nullopt;
+  }
+  if (step_a == 0 || step_b == 0) {
+    int128_t const step = step_a == 0 ? step_b : step_a;
+    if (target % step != 0) {
+      return std::nullopt;
     }
+    return step_a == 0 ? std::pair<int128_t, int128_t>{0, target / step}
+                       : std::pair<int128_t, int128_t>{target / step, 0};
   }
 
-  auto find_it = position_cost.find({0, 0});
-  if (find_it != position_cost.end()) {
-    return find_it->second;
+  // extended euclid: step_a * coef_a + step_b * coef_b = gcd
+  auto [old_r, r] = std::pair{step_a, step_b};
+  auto [old_s, s] = std::pair{int128_t{1}, int128_t{0}};
+  auto [old_t, t] = std::pair{int128_t{0}, int128_t{1}};
+  while (r != 0) {
+    int128_t const quotient = old_r / r;
+    std::tie(old_r, r) = std::pair{r, old_r - (quotient * r)};
+    std::tie(old_s, s) = std::pair{s, old_s - (quotient * s)};
+    std::tie(old_t, t) = std::pair{t, old_t - (quotient * t)};
+  }
+  int128_t const gcd = old_r;
+  if (target % gcd != 0) {
+    return std::nullopt;
   }
+  int128_t const a0 = old_s * (target / gcd);
+  int128_t const b0 = old_t * (target / gcd);
+  int128_t const shift_a = step_b / gcd;
+  int128_t const shift_b = step_a / gcd;
 
-  return 0;
+  int128_t const min_t = ceil_div(-a0, shift_a);
+  int128_t const max_t = floor_div(b0, shift_b);
+  if (min_t > max_t) {
+    return std::nullopt;
+  }
+  int128_t const slope = (cost_a * shift_a) - (cost_b * shift_b);
+  int128_t const best_t = slope > 0 ? min_t : max_t;
+  return std::pair{a0 + (best_t * shift_a), b0 - (best_t * shift_b)};
+}
+
+int128_t
+floor_div(int128_t num, int128_t den) {
+  int128_t const quotient = num / den;
+  return (num % den != 0 && (num < 0) != (den < 0)) ? quotient - 1 : quotient;
+}
+
+int128_t
+ceil_div(int128_t num, int128_t den) {
+  int128_t const quotient = num / den;
+  return (num % den != 0 && (num < 0) == (den < 0)) ? quotient + 1 : quotient;
 }
 } // namespace
@@ -2,22 +2,50 @@
 #include <cstdint>
 #include <fmt/core.h>
 #include <fstream>
-#include <functional> // multiplies
 #include <libassert/assert.hpp>
 #include <ranges>
 #include <scn/scan.h>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
-#include "matrix.hpp"
+#include "utility.hpp" // uint128_t
 
-struct Robot
+/// the robots as one array per coordinate, so that advancing them is a plain
+/// loop over 32-bit lanes that the compiler can vectorise; the velocities are
+/// wrapped into [0, width) and [0, length) once, when parsing
+struct Robots
 {
-  std::uint64_t x;
-  std::uint64_t y;
-  std::int64_t vx;
-  std::int64_t vy;
+  std::vector<std::uint32_t> xs;
+  std::vector<std::uint32_t> ys;
+  std::vector<std::uint32_t> vxs;
+  std::vector<std::uint32_t> vys;
+};
+
+/// `val % mod` for a fixed `mod`, by multiplying with a precomputed
+/// reciprocal instead of dividing
+class BarrettReducer
+{
+private:
+  std::uint64_t m_mod;
+  std::uint64_t m_factor;
+
+public:
+  explicit BarrettReducer(std::uint64_t mod)
+      : m_mod(mod),
+        m_factor(static_cast<std::uint64_t>((uint128_t{1} << 64) / mod)) {
+    ASSERT(mod > 1);
+  }
+
+  [[nodiscard]] std::uint64_t
+  reduce(std::uint64_t val) const {
+    // the estimated quotient is at most one below the real one
+    auto const quotient =
+        static_cast<std::uint64_t>((uint128_t{val} * m_factor) >> 64);
+    std::uint64_t const rem = val - quotient * m_mod;
+    return rem >= m_mod ? rem - m_mod : rem;
+  }
 };
 
 namespace
@@ -27,19 +55,32 @@ tests();
 std::uint64_t
 compute_safety_factor(std::ranges::range auto &&lines,
                       std::uint64_t seconds,
-                      std::uint64_t width,
-                      std::uint64_t length);
-std::vector<Robot>
-parse_robots(std::ranges::range auto &&lines);
+                      std::uint32_t width,
+                      std::uint32_t length);
+Robots
+parse_robots(std::ranges::range auto &&lines,
+             std::uint32_t width,
+             std::uint32_t length);
+std::uint32_t
+wrap_velocity(std::int64_t velocity, std::uint32_t period);
 void
-advance_robots(std::vector<Robot> &robots,
+advance_robots(Robots &robots,
                std::uint64_t seconds,
-               std::uint64_t width,
-               std::uint64_t length);
+               std::uint32_t width,
+               std::uint32_t length);
+void
+step_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint32_t period);
+void
+jump_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint64_t seconds,
+          std::uint32_t period);
 std::uint64_t
-compute_safety_factor(std::vector<Robot> const &robots,
-                      std::uint64_t width,
-                      std::uint64_t length);
+compute_safety_factor(Robots const &robots,
+                      std::uint32_t width,
+                      std::uint32_t length);
 } // namespace
 
 int
@@ -93,60 +134,128 @@ tests() {
     };
     ASSERT(compute_safety_factor(lines, 100, 11, 7) == 12);
   }
+  {
+    // a jump must land where the same number of single steps do
+    auto const lines = std::array{
+        "p=0,4 v=3,-3"sv,
+        "p=6,3 v=-1,-3"sv,
+        "p=9,5 v=-3,-3"sv,
+    };
+    auto jumped = parse_robots(lines, 11, 7);
+    auto stepped = jumped;
+    advance_robots(jumped, 1000, 11, 7);
+    for (std::size_t sec{}; sec < 1000; ++sec) {
+      advance_robots(stepped, 1, 11, 7);
+    }
+    ASSERT(jumped.xs == stepped.xs);
+    ASSERT(jumped.ys == stepped.ys);
+
+    std::uint64_t const max{~std::uint64_t{}};
+    for (std::uint64_t mod : std::array<std::uint64_t, 4>{
+             2, 101, std::uint64_t{1} << 31, (std::uint64_t{1} << 32) - 1}) {
+      BarrettReducer const reducer(mod);
+      for (std::uint64_t val : std::array{
+               std::uint64_t{}, mod - 1, mod, max, max / 3}) {
+        ASSERT(reducer.reduce(val) == val % mod);
+      }
+    }
+  }
 }
 
 std::uint64_t
 compute_safety_factor(std::ranges::range auto &&lines,
                       std::uint64_t seconds,
-                      std::uint64_t width,
-                      std::uint64_t length) {
-  auto robots{parse_robots(lines)};
+                      std::uint32_t width,
+                      std::uint32_t length) {
+  auto robots{parse_robots(lines, width, length)};
   advance_robots(robots, seconds, width, length);
   return compute_safety_factor(robots, width, length);
 }
-std::vector<Robot>
-parse_robots(std::ranges::range auto &&lines) {
-  std::vector<Robot> robots;
+
+Robots
+parse_robots(std::ranges::range auto &&lines,
+             std::uint32_t width,
+             std::uint32_t length) {
+  Robots robots;
   for (auto const &line : lines) {
     auto [x, y, vx, vy] =
-        scn::scan<std::uint64_t, std::uint64_t, std::int64_t, std::int64_t>(
+        scn::scan<std::uint32_t, std::uint32_t, std::int64_t, std::int64_t>(
             line,
             "p={},{} v={},{}")
             ->values();
-    robots.emplace_back(x, y, vx, vy);
+    ASSERT(x < width && y < length);
+    robots.xs.push_back(x);
+    robots.ys.push_back(y);
+    robots.vxs.push_back(wrap_velocity(vx, width));
+    robots.vys.push_back(wrap_velocity(vy, length));
   }
   return robots;
 }
 
+std::uint32_t
+wrap_velocity(std::int64_t velocity, std::uint32_t period) {
+  std::int64_t const mod{period};
+  return static_cast<std::uint32_t>(((velocity % mod) + mod) % mod);
+}
+
 void
-advance_robots(std::vector<Robot> &robots,
+advance_robots(Robots &robots,
                std::uint64_t seconds,
-               std::uint64_t width,
-               std::uint64_t length) {
-  for (auto &robot : robots) {
-    robot.x = (robot.x + ((width + robot.vx) % width) * seconds) % width;
-    robot.y = (robot.y + ((length + robot.vy) % length) * seconds) % length;
+               std::uint32_t width,
+               std::uint32_t length) {
+  if (seconds == 1) {
+    step_axis(robots.xs, robots.vxs, width);
+    step_axis(robots.ys, robots.vys, length);
+  } else {
+    jump_axis(robots.xs, robots.vxs, seconds, width);
+    jump_axis(robots.ys, robots.vys, seconds, length);
+  }
+}
+
+/// both the position and the step are below `period`, so a single second
+/// wraps at most once, and a conditional subtraction replaces the modulo
+void
+step_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint32_t period) {
+  ASSERT(period <= std::uint32_t{1} << 31);
+  for (std::size_t idx{}; idx < positions.size(); ++idx) {
+    std::uint32_t const pos = positions[idx] + steps[idx];
+    positions[idx] = pos >= period ? pos - period : pos;
+  }
+}
+
+void
+jump_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint64_t seconds,
+          std::uint32_t period) {
+  if (period == 1) {
+    return;
+  }
+  BarrettReducer const reducer(period);
+  std::uint64_t const jump = reducer.reduce(seconds);
+  for (std::size_t idx{}; idx < positions.size(); ++idx) {
+    positions[idx] = static_cast<std::uint32_t>(reducer.reduce(
+        positions[idx] + std::uint64_t{steps[idx]} * jump));
   }
 }
 
+/// every robot falls into one of 3x3 buckets, depending on whether each of
+/// its coordinates is before, on, or after the middle line; the bucket index
+/// is computed without branches, and only the four corner buckets count
 std::uint64_t
-compute_safety_factor(std::vector<Robot> const &robots,
-                      std::uint64_t width,
-                      std::uint64_t length) {
-  std::array<std::uint64_t, 4> quadrant_count{};
-  for (Robot const &robot : robots) {
-    if (robot.x < width / 2 && robot.y < length / 2) {
-      ++quadrant_count[0];
-    } else if (robot.x > width / 2 && robot.y < length / 2) {
-      ++quadrant_count[1];
-    } else if (robot.x < width / 2 && robot.y > length / 2) {
-      ++quadrant_count[2];
-    } else if (robot.x > width / 2 && robot.y > length / 2) {
-      ++quadrant_count[3];
-    }
+compute_safety_factor(Robots const &robots,
+                      std::uint32_t width,
+                      std::uint32_t length) {
+  auto side = [](std::uint32_t pos, std::uint32_t middle) {
+    return static_cast<std::size_t>(pos >= middle) + (pos > middle);
+  };
+  std::array<std::uint64_t, 9> buckets{};
+  for (std::size_t idx{}; idx < robots.xs.size(); ++idx) {
+    ++buckets[(3 * side(robots.ys[idx], length / 2))
+              + side(robots.xs[idx], width / 2)];
   }
-  return std::ranges::fold_left(quadrant_count,
-                                1,
-                                std::multiplies<std::uint64_t>{});
+  return buckets[0] * buckets[2] * buckets[6] * buckets[8];
 }
 } // namespace
@@ -1,44 +1,147 @@
+#include <array>
+#include <bit>
 #include <cstdint>
 #include <fmt/core.h>
 #include <fstream>
 #include <libassert/assert.hpp>
 #include <ranges>
 #include <scn/scan.h>
+#include <span>
 #include <string>
+#include <string_view>
 #include <utility>
+#include <vector>
 
-#include "matrix.hpp"
+#include "utility.hpp" // uint128_t
 
-struct Robot
+/// the robots as one array per coordinate, so that advancing them is a plain
+/// loop over 32-bit lanes that the compiler can vectorise; the velocities are
+/// wrapped into [0, width) and [0, length) once, when parsing
+struct Robots
 {
-  std::uint64_t x;
-  std::uint64_t y;
-  std::int64_t vx;
-  std::int64_t vy;
+  std::vector<std::uint32_t> xs;
+  std::vector<std::uint32_t> ys;
+  std::vector<std::uint32_t> vxs;
+  std::vector<std::uint32_t> vys;
+};
+
+/// `val % mod` for a fixed `mod`, by multiplying with a precomputed
+/// reciprocal instead of dividing
+class BarrettReducer
+{
+private:
+  std::uint64_t m_mod;
+  std::uint64_t m_factor;
+
+public:
+  explicit BarrettReducer(std::uint64_t mod)
+      : m_mod(mod),
+        m_factor(static_cast<std::uint64_t>((uint128_t{1} << 64) / mod)) {
+    ASSERT(mod > 1);
+  }
+
+  [[nodiscard]] std::uint64_t
+  reduce(std::uint64_t val) const {
+    // the estimated quotient is at most one below the real one
+    auto const quotient =
+        static_cast<std::uint64_t>((uint128_t{val} * m_factor) >> 64);
+    std::uint64_t const rem = val - quotient * m_mod;
+    return rem >= m_mod ? rem - m_mod : rem;
+  }
+};
+
+/// a frame of the robots, as one bitmask per row; a set bit means that at
+/// least one robot is in that cell, so the clustering metrics below are
+/// popcounts and shifts over whole words instead of loops over cells
+class Frame
+{
+private:
+  std::size_t m_width;
+  std::size_t m_length;
+  std::size_t m_words_per_row;
+  std::vector<std::uint64_t> m_bits;
+  /// robots can share a cell, so a bit is only flipped when its cell gets its
+  /// first robot or loses its last one
+  std::vector<std::uint32_t> m_counts;
+
+  [[nodiscard]] std::span<std::uint64_t const>
+  row(std::size_t y) const;
+  void
+  flip(std::uint32_t x, std::uint32_t y);
+
+public:
+  Frame(std::uint32_t width, std::uint32_t length);
+
+  void
+  add(std::uint32_t x, std::uint32_t y);
+  void
+  remove(std::uint32_t x, std::uint32_t y);
+  [[nodiscard]] bool
+  is_set(std::uint32_t x, std::uint32_t y) const;
+  [[nodiscard]] std::uint64_t
+  num_adjacent_pairs() const;
+  [[nodiscard]] std::uint64_t
+  longest_run() const;
+  [[nodiscard]] std::uint64_t
+  num_full_neighbourhoods() const;
 };
 
 namespace
 {
+void
+tests();
+std::uint64_t
+find_easter_egg_by_axes(std::ranges::range auto &&lines,
+                        std::uint32_t width,
+                        std::uint32_t length);
 std::uint64_t
 find_easter_egg(std::ranges::range auto &&lines,
                 std::uint64_t seconds,
-                std::uint64_t width,
-                std::uint64_t length);
-std::vector<Robot>
-parse_robots(std::ranges::range auto &&lines);
+                std::uint32_t width,
+                std::uint32_t length);
+Robots
+parse_robots(std::ranges::range auto &&lines,
+             std::uint32_t width,
+             std::uint32_t length);
+std::uint32_t
+wrap_velocity(std::int64_t velocity, std::uint32_t period);
 void
-advance_robots(std::vector<Robot> &robots,
+advance_robots(Robots &robots,
                std::uint64_t seconds,
-               std::uint64_t width,
-               std::uint64_t length);
+               std::uint32_t width,
+               std::uint32_t length);
 void
-populate_grid(std::vector<Robot> const &robots, Matrix<char> &grid);
+step_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint32_t period);
+void
+jump_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint64_t seconds,
+          std::uint32_t period);
 bool
-is_tree(Matrix<char> const &grid);
+is_tree(Frame const &frame);
+std::uint64_t
+left_neighbours(std::span<std::uint64_t const> row, std::size_t word);
+std::uint64_t
+right_neighbours(std::span<std::uint64_t const> row, std::size_t word);
+std::uint64_t
+find_tightest_offset(std::vector<std::uint32_t> positions,
+                     std::vector<std::uint32_t> const &steps,
+                     std::uint32_t period);
+std::uint64_t
+mod_inverse(std::uint64_t num, std::uint64_t mod);
+std::uint64_t
+chinese_remainder(std::uint64_t rem1,
+                  std::uint64_t mod1,
+                  std::uint64_t rem2,
+                  std::uint64_t mod2);
 } // namespace
 
 int
 main(int argc, char const *const *argv) {
+  tests();
+
   auto args = std::span(argv, size_t(argc));
   if (args.size() != 2) {
     fmt::println(stderr, "usage: {} input.txt", args[0]);
@@ -56,83 +159,379 @@ main(int argc, char const *const *argv) {
     lines.emplace_back(std::move(line));
   }
 
-  fmt::println("{}", find_easter_egg(lines, 1000000, 101, 103));
+  fmt::println("{}", find_easter_egg_by_axes(lines, 101, 103));
   return 0;
 }
 
 namespace
 {
+void
+tests() {
+  using namespace std::literals::string_view_literals;
+  {
+    // a 3x3 block straddling two words, with a longer middle row
+    Frame frame(70, 3);
+    for (std::uint32_t x = 62; x < 65; ++x) {
+      frame.add(x, 0);
+      frame.add(x, 2);
+    }
+    for (std::uint32_t x = 62; x < 68; ++x) {
+      frame.add(x, 1);
+    }
+    ASSERT(frame.num_adjacent_pairs() == 15);
+    ASSERT(frame.longest_run() == 6);
+    ASSERT(frame.num_full_neighbourhoods() == 1);
+
+    // a cell only empties once its last robot leaves
+    frame.add(63, 0);
+    frame.remove(63, 0);
+    ASSERT(frame.is_set(63, 0));
+    ASSERT(frame.num_full_neighbourhoods() == 1);
+    frame.remove(63, 0);
+    ASSERT(!frame.is_set(63, 0));
+    ASSERT(frame.num_full_neighbourhoods() == 0);
+    ASSERT(frame.num_adjacent_pairs() == 12);
+  }
+  {
+    ASSERT(chinese_remainder(7, 11, 5, 7) == 40);
+    ASSERT(chinese_remainder(0, 101, 0, 103) == 0);
+    ASSERT(chinese_remainder(89, 101, 30, 103) == 8270);
+  }
+  {
+    // all the robots gather in a 6x6 block after 40 seconds
+    auto const lines = std::array{
+        "p=10,2 v=2,1"sv,
+        "p=5,5 v=-5,-1"sv,
+        "p=9,2 v=4,1"sv,
+        "p=2,5 v=2,-1"sv,
+        "p=7,5 v=3,-1"sv,
+        "p=5,3 v=5,-2"sv,
+        "p=7,4 v=4,-2"sv,
+        "p=10,4 v=-1,-2"sv,
+        "p=10,5 v=-4,2"sv,
+        "p=1,5 v=-1,2"sv,
+        "p=4,4 v=5,-2"sv,
+        "p=3,2 v=-1,-3"sv,
+        "p=8,1 v=-4,3"sv,
+        "p=7,4 v=1,1"sv,
+        "p=9,3 v=4,-3"sv,
+        "p=9,4 v=1,1"sv,
+        "p=10,6 v=1,2"sv,
+        "p=10,6 v=-2,2"sv,
+        "p=3,5 v=3,1"sv,
+        "p=8,1 v=4,-1"sv,
+        "p=6,0 v=-5,2"sv,
+        "p=7,4 v=-5,-3"sv,
+        "p=3,2 v=2,3"sv,
+        "p=9,0 v=-5,2"sv,
+        "p=3,2 v=3,-1"sv,
+        "p=6,3 v=-2,3"sv,
+        "p=8,3 v=1,3"sv,
+        "p=0,0 v=-4,-2"sv,
+        "p=4,0 v=5,-2"sv,
+        "p=10,0 v=-2,-2"sv,
+        "p=7,0 v=4,1"sv,
+        "p=9,6 v=-4,-3"sv,
+        "p=8,2 v=1,2"sv,
+        "p=6,6 v=3,-3"sv,
+        "p=2,2 v=-1,2"sv,
+        "p=3,4 v=-1,3"sv,
+    };
+    ASSERT(find_easter_egg(lines, 77, 11, 7) == 40);
+    ASSERT(find_easter_egg_by_axes(lines, 11, 7) == 40);
+  }
+}
+
+/// the robots move independently along each axis, and every axis repeats
+/// with its own period; so the time at which the robots cluster the most in
+/// x is found over `width` seconds, the one for y over `length` seconds, and
+/// the two are combined with the chinese remainder theorem, which needs
+/// coprime sides
+std::uint64_t
+find_easter_egg_by_axes(std::ranges::range auto &&lines,
+                        std::uint32_t width,
+                        std::uint32_t length) {
+  Robots robots{parse_robots(lines, width, length)};
+  std::uint64_t const offset_x = find_tightest_offset(
+      std::move(robots.xs), robots.vxs, width);
+  std::uint64_t const offset_y = find_tightest_offset(
+      std::move(robots.ys), robots.vys, length);
+  return chinese_remainder(offset_x, width, offset_y, length);
+}
+
 std::uint64_t
 find_easter_egg(std::ranges::range auto &&lines,
                 std::uint64_t seconds,
-                std::uint64_t width,
-                std::uint64_t length) {
-  auto robots{parse_robots(lines)};
-  Matrix<char> grid(length, width, ' ');
+                std::uint32_t width,
+                std::uint32_t length) {
+  auto robots{parse_robots(lines, width, length)};
+  Frame frame(width, length);
+  for (std::size_t idx{}; idx < robots.xs.size(); ++idx) {
+    frame.add(robots.xs[idx], robots.ys[idx]);
+  }
+  // only the cells the robots leave and enter change between two frames
   for (std::uint64_t sec = 1; sec <= seconds; ++sec) {
+    for (std::size_t idx{}; idx < robots.xs.size(); ++idx) {
+      frame.remove(robots.xs[idx], robots.ys[idx]);
+    }
     advance_robots(robots, 1, width, length);
-    populate_grid(robots, grid);
-    if (is_tree(grid)) {
-      grid.print();
+    for (std::size_t idx{}; idx < robots.xs.size(); ++idx) {
+      frame.add(robots.xs[idx], robots.ys[idx]);
+    }
+    if (is_tree(frame)) {
       return sec;
     }
-    grid.clear(' ');
   }
   return 0;
 }
-std::vector<Robot>
-parse_robots(std::ranges::range auto &&lines) {
-  std::vector<Robot> robots;
+Robots
+parse_robots(std::ranges::range auto &&lines,
+             std::uint32_t width,
+             std::uint32_t length) {
+  Robots robots;
   for (auto const &line : lines) {
     auto [x, y, vx, vy] =
-        scn::scan<std::uint64_t, std::uint64_t, std::int64_t, std::int64_t>(
+        scn::scan<std::uint32_t, std::uint32_t, std::int64_t, std::int64_t>(
             line,
             "p={},{} v={},{}")
             ->values();
-    robots.emplace_back(x, y, vx, vy);
+    ASSERT(x < width && y < length);
+    robots.xs.push_back(x);
+    robots.ys.push_back(y);
+    robots.vxs.push_back(wrap_velocity(vx, width));
+    robots.vys.push_back(wrap_velocity(vy, length));
   }
   return robots;
 }
 
+std::uint32_t
+wrap_velocity(std::int64_t velocity, std::uint32_t period) {
+  std::int64_t const mod{period};
+  return static_cast<std::uint32_t>(((velocity % mod) + mod) % mod);
+}
+
 void
-advance_robots(std::vector<Robot> &robots,
+advance_robots(Robots &robots,
                std::uint64_t seconds,
-               std::uint64_t width,
-               std::uint64_t length) {
-  for (auto &robot : robots) {
-    robot.x = (robot.x + ((width + robot.vx) % width) * seconds) % width;
-    robot.y = (robot.y + ((length + robot.vy) % length) * seconds) % length;
+               std::uint32_t width,
+               std::uint32_t length) {
+  if (seconds == 1) {
+    step_axis(robots.xs, robots.vxs, width);
+    step_axis(robots.ys, robots.vys, length);
+  } else {
+    jump_axis(robots.xs, robots.vxs, seconds, width);
+    jump_axis(robots.ys, robots.vys, seconds, length);
+  }
+}
+
+/// both the position and the step are below `period`, so a single second
+/// wraps at most once, and a conditional subtraction replaces the modulo
+void
+step_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint32_t period) {
+  ASSERT(period <= std::uint32_t{1} << 31);
+  for (std::size_t idx{}; idx < positions.size(); ++idx) {
+    std::uint32_t const pos = positions[idx] + steps[idx];
+    positions[idx] = pos >= period ? pos - period : pos;
   }
 }
 
 void
-populate_grid(std::vector<Robot> const &robots, Matrix<char> &grid) {
-  for (Robot const &robot : robots) {
-    grid(robot.y, robot.x) = 'X';
+jump_axis(std::vector<std::uint32_t> &positions,
+          std::vector<std::uint32_t> const &steps,
+          std::uint64_t seconds,
+          std::uint32_t period) {
+  if (period == 1) {
+    return;
+  }
+  BarrettReducer const reducer(period);
+  std::uint64_t const jump = reducer.reduce(seconds);
+  for (std::size_t idx{}; idx < positions.size(); ++idx) {
+    positions[idx] = static_cast<std::uint32_t>(reducer.reduce(
+        positions[idx] + std::uint64_t{steps[idx]} * jump));
   }
 }
 
+/// the picture has a solid frame around it, so it shows up as many robots
+/// whose eight neighbours are all robots too
 bool
-is_tree(Matrix<char> const &grid) {
-  std::size_t num_touching_all{};
-  for (std::size_t row = 1; row < grid.rows() - 1; ++row) {
-    for (std::size_t col = 1; col < grid.cols() - 1; ++col) {
-      auto middle = grid(row, col);
-      if (middle != 'X') {
+is_tree(Frame const &frame) {
+  return frame.num_full_neighbourhoods() > 10;
+}
+
+/// every bit of the result is the bit to the left of it in the row
+std::uint64_t
+left_neighbours(std::span<std::uint64_t const> row, std::size_t word) {
+  std::uint64_t const carry = word == 0 ? 0 : row[word - 1] >> 63;
+  return (row[word] << 1) | carry;
+}
+
+/// every bit of the result is the bit to the right of it in the row
+std::uint64_t
+right_neighbours(std::span<std::uint64_t const> row, std::size_t word) {
+  std::uint64_t const carry = word + 1 == row.size() ? 0 : row[word + 1] << 63;
+  return (row[word] >> 1) | carry;
+}
+
+/// the time in [0, period) at which the positions are the least spread out;
+/// the spread is the variance scaled by the squared number of robots, so that
+/// it stays an integer
+std::uint64_t
+find_tightest_offset(std::vector<std::uint32_t> positions,
+                     std::vector<std::uint32_t> const &steps,
+                     std::uint32_t period) {
+  ASSERT(positions.size() == steps.size());
+  auto const num_robots = static_cast<uint128_t>(positions.size());
+  uint128_t best_spread = ~uint128_t{};
+  std::uint64_t best_offset{};
+  for (std::uint64_t offset{}; offset < period; ++offset) {
+    uint128_t sum{};
+    uint128_t sum_squares{};
+    for (std::size_t idx{}; idx < positions.size(); ++idx) {
+      sum += positions[idx];
+      sum_squares += uint128_t{positions[idx]} * positions[idx];
+    }
+    step_axis(positions, steps, period);
+    uint128_t const spread = num_robots * sum_squares - sum * sum;
+    if (spread < best_spread) {
+      best_spread = spread;
+      best_offset = offset;
+    }
+  }
+  return best_offset;
+}
+
+/// extended euclid; `num` and `mod` must be coprime
+std::uint64_t
+mod_inverse(std::uint64_t num, std::uint64_t mod) {
+  auto [old_r, r] = std::pair{static_cast<std::int64_t>(num % mod),
+                              static_cast<std::int64_t>(mod)};
+  auto [old_s, s] = std::pair{std::int64_t{1}, std::int64_t{0}};
+  while (r != 0) {
+    std::int64_t const quotient = old_r / r;
+    std::tie(old_r, r) = std::pair{r, old_r - quotient * r};
+    std::tie(old_s, s) = std::pair{s, old_s - quotient * s};
+  }
+  ASSERT(old_r == 1, "not coprime", num, mod);
+  auto const signed_mod = static_cast<std::int64_t>(mod);
+  return static_cast<std::uint64_t>(((old_s % signed_mod) + signed_mod)
+                                    % signed_mod);
+}
+
+/// the only t in [0, mod1 * mod2) with t = rem1 (mod mod1) and
+/// t = rem2 (mod mod2)
+std::uint64_t
+chinese_remainder(std::uint64_t rem1,
+                  std::uint64_t mod1,
+                  std::uint64_t rem2,
+                  std::uint64_t mod2) {
+  // t = rem1 + mod1 * k, with mod1 * k = rem2 - rem1 (mod mod2)
+  std::uint64_t const diff = (rem2 % mod2 + mod2 - rem1 % mod2) % mod2;
+  auto const k = static_cast<std::uint64_t>(
+      uint128_t{diff} * mod_inverse(mod1, mod2) % mod2);
+  return rem1 + mod1 * k;
+}
+} // namespace
+
+Frame::Frame(std::uint32_t width, std::uint32_t length)
+    : m_width(width),
+      m_length(length),
+      m_words_per_row((m_width + 63) / 64),
+      m_bits(m_length * m_words_per_row),
+      m_counts(m_length * m_width) {}
+
+std::span<std::uint64_t const>
+Frame::row(std::size_t y) const {
+  return std::span(m_bits).subspan(y * m_words_per_row, m_words_per_row);
+}
+
+void
+Frame::flip(std::uint32_t x, std::uint32_t y) {
+  m_bits[(y * m_words_per_row) + (x / 64)] ^= std::uint64_t{1} << (x % 64);
+}
+
+void
+Frame::add(std::uint32_t x, std::uint32_t y) {
+  if (m_counts[(y * m_width) + x]++ == 0) {
+    flip(x, y);
+  }
+}
+
+void
+Frame::remove(std::uint32_t x, std::uint32_t y) {
+  DEBUG_ASSERT(m_counts[(y * m_width) + x] > 0);
+  if (--m_counts[(y * m_width) + x] == 0) {
+    flip(x, y);
+  }
+}
+
+bool
+Frame::is_set(std::uint32_t x, std::uint32_t y) const {
+  return ((row(y)[x / 64] >> (x % 64)) & 1) != 0;
+}
+
+/// the number of pairs of occupied cells next to each other, horizontally or
+/// vertically
+std::uint64_t
+Frame::num_adjacent_pairs() const {
+  std::uint64_t num_pairs{};
+  for (std::size_t y{}; y < m_length; ++y) {
+    auto const curr = row(y);
+    for (std::size_t word{}; word < m_words_per_row; ++word) {
+      num_pairs += static_cast<std::uint64_t>(
+          std::popcount(curr[word] & right_neighbours(curr, word)));
+      if (y + 1 < m_length) {
+        num_pairs += static_cast<std::uint64_t>(
+            std::popcount(curr[word] & row(y + 1)[word]));
+      }
+    }
+  }
+  return num_pairs;
+}
+
+/// the longest horizontal line of occupied cells; a run can span several
+/// words, so the ones at the top of a word carry over into the next one
+std::uint64_t
+Frame::longest_run() const {
+  std::uint64_t longest{};
+  for (std::size_t y{}; y < m_length; ++y) {
+    std::uint64_t run{};
+    for (std::uint64_t bits : row(y)) {
+      if (bits == ~std::uint64_t{}) {
+        run += 64;
         continue;
       }
-      for (std::size_t subrow = row - 1; subrow < row + 1; ++subrow) {
-        for (std::size_t subcol = col - 1; subcol < col + 1; ++subcol) {
-          if (grid(subrow, subcol) != middle) {
-            goto nope;
-          }
-        }
+      longest = std::max(
+          longest, run + static_cast<std::uint64_t>(std::countr_one(bits)));
+      // every step shortens all the runs inside the word by one
+      std::uint64_t inner{};
+      for (std::uint64_t rest = bits; rest != 0; rest &= rest >> 1) {
+        ++inner;
       }
-      ++num_touching_all;
-    nope:
+      longest = std::max(longest, inner);
+      run = static_cast<std::uint64_t>(std::countl_one(bits));
     }
+    longest = std::max(longest, run);
   }
-  return num_touching_all > 10;
+  return longest;
 }
 
-} // namespace
+/// the number of occupied cells whose eight neighbours are all occupied
+std::uint64_t
+Frame::num_full_neighbourhoods() const {
+  auto full_across = [this](std::size_t y, std::size_t word) {
+    auto const curr = row(y);
+    return curr[word] & left_neighbours(curr, word)
+           & right_neighbours(curr, word);
+  };
+  std::uint64_t num_full{};
+  for (std::size_t y = 1; y + 1 < m_length; ++y) {
+    for (std::size_t word{}; word < m_words_per_row; ++word) {
+      num_full += static_cast<std::uint64_t>(
+          std::popcount(full_across(y - 1, word) & full_across(y, word)
+                        & full_across(y + 1, word)));
+    }
+  }
+  return num_full;
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <fmt/core.h>
@@ -8,6 +9,7 @@
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "matrix.hpp"
 
@@ -17,6 +19,19 @@ struct Robot
   std::uint64_t y;
 };
 
+/// a wall or a box, each covering the single cell (x, y)
+struct Item
+{
+  bool is_block;
+  std::uint64_t x;
+  std::uint64_t y;
+};
+
+/// marks the cells of the occupancy grid that no item covers
+static constexpr std::uint32_t NO_ITEM{~std::uint32_t{}};
+/// the number of cells covered by every wall and box
+static constexpr std::size_t BOX_WIDTH{1};
+
 enum class Move
 {
   UP,
@@ -25,28 +40,100 @@ enum class Move
   RIGHT,
 };
 
+/// `count` consecutive copies of the same move
+struct MoveRun
+{
+  Move move;
+  std::uint64_t count;
+};
+
+/// a point in a stream of move runs: the first `num_moves` moves, made of the
+/// first `run_idx` runs plus `run_offset` moves of the next one
+struct MovePosition
+{
+  std::uint64_t num_moves;
+  std::size_t run_idx;
+  std::uint64_t run_offset;
+};
+
+/// everything needed to resume a warehouse from a position in its moves
+struct Checkpoint
+{
+  MovePosition position;
+  Robot robot;
+  std::vector<Item> items;
+  std::uint64_t gps_sum;
+};
+
 namespace
 {
 void
 tests();
+/// the robot and the items of a warehouse, whose walls and boxes are
+/// `BOX_WIDTH` cells wide; every cell of the grid records the id of the item
+/// covering it, so a push only ever looks at the cells right in front of the
+/// items it moves
+class Warehouse
+{
+private:
+  Robot m_robot;
+  std::vector<Item> m_items;
+  Matrix<std::uint32_t> m_occupancy;
+  /// `m_visited[id] == m_num_pushes` if the current push has already reached
+  /// the item; bumping the counter resets all the marks at once
+  std::vector<std::uint64_t> m_visited;
+  std::uint64_t m_num_pushes{};
+  /// the items taking part in the current push, reused between moves
+  std::vector<std::uint32_t> m_to_move;
+  /// kept up to date by every push, instead of summing all the boxes at the end
+  std::uint64_t m_gps_sum{};
+
+  bool
+  push(std::uint32_t first, Move move);
+  void
+  place(std::uint32_t id, std::uint32_t value);
+  void
+  place_all();
+
+public:
+  Warehouse(std::size_t rows,
+            std::size_t cols,
+            Robot robot,
+            std::vector<Item> items);
+
+  bool
+  move(Move move);
+  void
+  move(MoveRun const &run);
+  [[nodiscard]] Checkpoint
+  checkpoint(MovePosition const &position) const;
+  void
+  restore(Checkpoint const &checkpoint);
+  [[nodiscard]] std::uint32_t
+  item_at(std::uint64_t x, std::uint64_t y) const;
+  [[nodiscard]] Robot const &
+  robot() const;
+  [[nodiscard]] std::uint64_t
+  sum_of_gps_coord() const;
+};
+
 std::uint64_t
 sum_of_gps_coord(std::ranges::range auto &&lines);
-std::tuple<Robot, std::vector<Move>, Matrix<char>>
-parse_robot_moves_grid(std::ranges::range auto &&lines);
-void
-perform_movements(Robot &robot,
-                  std::vector<Move> const &moves,
-                  Matrix<char> &grid);
-void
-move_up(Robot &robot, Matrix<char> &grid);
+std::tuple<Warehouse, std::vector<MoveRun>>
+parse_warehouse_moves(std::ranges::range auto &&lines);
+std::vector<Checkpoint>
+perform_movements(Warehouse &warehouse,
+                  std::vector<MoveRun> const &runs,
+                  std::uint64_t interval);
 void
-move_down(Robot &robot, Matrix<char> &grid);
-void
-move_left(Robot &robot, Matrix<char> &grid);
-void
-move_right(Robot &robot, Matrix<char> &grid);
+replay_until(Warehouse &warehouse,
+             std::vector<MoveRun> const &runs,
+             std::vector<Checkpoint> const &checkpoints,
+             std::uint64_t num_moves);
+std::pair<std::uint64_t, std::uint64_t>
+next_cell(std::uint64_t x, std::uint64_t y, Move move);
 std::uint64_t
-sum_of_gps_coord(Matrix<char> const &grid);
+gps_coord(Item const &item);
 } // namespace
 
 int
@@ -120,190 +207,328 @@ tests() {
     };
     ASSERT(sum_of_gps_coord(lines) == 10092);
   }
+  {
+    auto const lines = std::array{
+        "########"sv,
+        "#..O.O.#"sv,
+        "##@.O..#"sv,
+        "#...O..#"sv,
+        "#.#.O..#"sv,
+        "#...O..#"sv,
+        "#......#"sv,
+        "########"sv,
+        ""sv,
+        "<^^>>>vv<v>>v<<"sv,
+    };
+    auto [warehouse, runs] = parse_warehouse_moves(lines);
+    // consecutive copies of a move are read as a single run
+    ASSERT(runs.size() == 9);
+    ASSERT(runs[1].move == Move::UP && runs[1].count == 2);
+    ASSERT(runs[2].move == Move::RIGHT && runs[2].count == 3);
+    ASSERT(warehouse.item_at(3, 1) != NO_ITEM);
+    ASSERT(warehouse.item_at(2, 1) == NO_ITEM);
+
+    // replaying from any checkpoint must agree with running straight through
+    auto const checkpoints = perform_movements(warehouse, runs, 4);
+    ASSERT(checkpoints.size() == 4);
+    for (std::uint64_t num_moves{}; num_moves <= 15; ++num_moves) {
+      auto [expected, expected_runs] = parse_warehouse_moves(lines);
+      std::uint64_t remaining = num_moves;
+      for (auto const &[move, count] : expected_runs) {
+        for (std::uint64_t idx{}; idx < count && remaining != 0; ++idx) {
+          expected.move(move);
+          --remaining;
+        }
+      }
+      replay_until(warehouse, runs, checkpoints, num_moves);
+      ASSERT(warehouse.sum_of_gps_coord() == expected.sum_of_gps_coord());
+      ASSERT(warehouse.robot().x == expected.robot().x);
+      ASSERT(warehouse.robot().y == expected.robot().y);
+    }
+  }
 }
 
 std::uint64_t
 sum_of_gps_coord(std::ranges::range auto &&lines) {
-  auto [robot, moves, grid] = parse_robot_moves_grid(lines);
-  perform_movements(robot, moves, grid);
-  return sum_of_gps_coord(grid);
+  auto [warehouse, runs] = parse_warehouse_moves(lines);
+  for (MoveRun const &run : runs) {
+    warehouse.move(run);
+  }
+  return warehouse.sum_of_gps_coord();
 }
 
-std::tuple<Robot, std::vector<Move>, Matrix<char>>
-parse_robot_moves_grid(std::ranges::range auto &&lines) {
+std::tuple<Warehouse, std::vector<MoveRun>>
+parse_warehouse_moves(std::ranges::range auto &&lines) {
   // find the number of rows in the grid
   auto const rows = static_cast<std::size_t>(
       std::distance(lines.begin(), std::ranges::find(lines, "")));
   auto const cols = lines[0].size();
 
-  Matrix<char> grid(rows, cols, ' ');
+  std::vector<Item> items;
   Robot robot{};
   for (std::size_t row{}; row < rows; ++row) {
     for (std::size_t col{}; col < cols; ++col) {
       auto ch = lines[row][col];
       switch (ch) {
-      case '#':
+      case '#': {
+        items.emplace_back(true, col * BOX_WIDTH, row);
+        break;
+      }
       case 'O': {
-        grid(row, col) = ch;
+        items.emplace_back(false, col * BOX_WIDTH, row);
         break;
       }
       case '@': {
-        robot = Robot{row, col};
+        robot = Robot{col * BOX_WIDTH, row};
+        break;
+      }
+      case '.': {
+        break;
+      }
+      default: {
+        UNREACHABLE(ch);
       }
       }
     }
   }
 
-  std::vector<Move> moves;
+  std::vector<MoveRun> runs;
   for (auto const &line : lines | std::views::drop(rows + 1)) {
-    std::ranges::transform(line, std::back_inserter(moves), [](char ch) {
+    for (char ch : line) {
+      Move move{};
       switch (ch) {
       case '^': {
-        return Move::UP;
+        move = Move::UP;
+        break;
       }
       case 'v': {
-        return Move::DOWN;
+        move = Move::DOWN;
+        break;
       }
       case '<': {
-        return Move::LEFT;
+        move = Move::LEFT;
+        break;
       }
       case '>': {
-        return Move::RIGHT;
+        move = Move::RIGHT;
+        break;
       }
       default: {
         UNREACHABLE(ch);
       }
       }
-    });
+      if (!runs.empty() && runs.back().move == move) {
+        ++runs.back().count;
+      } else {
+        runs.emplace_back(move, 1);
+      }
+    }
   }
-  return {robot, moves, grid};
+  return {Warehouse(rows, cols * BOX_WIDTH, robot, std::move(items)), runs};
 }
 
-void
-perform_movements(Robot &robot,
-                  std::vector<Move> const &moves,
-                  Matrix<char> &grid) {
-  for (Move const &move : moves) {
-    switch (move) {
-    case Move::UP: {
-      move_up(robot, grid);
-      break;
-    }
-    case Move::DOWN: {
-      move_down(robot, grid);
-      break;
-    }
-    case Move::LEFT: {
-      move_left(robot, grid);
-      break;
-    }
-    case Move::RIGHT: {
-      move_right(robot, grid);
-      break;
-    }
+/// runs all the moves, taking a checkpoint at the start and then every
+/// `interval` moves; a run that straddles a checkpoint is split around it
+std::vector<Checkpoint>
+perform_movements(Warehouse &warehouse,
+                  std::vector<MoveRun> const &runs,
+                  std::uint64_t interval) {
+  ASSERT(interval > 0);
+  std::vector<Checkpoint> checkpoints{warehouse.checkpoint({0, 0, 0})};
+  std::uint64_t num_moves{};
+  for (std::size_t run_idx{}; run_idx < runs.size(); ++run_idx) {
+    MoveRun const &run = runs[run_idx];
+    for (std::uint64_t offset{}; offset < run.count;) {
+      std::uint64_t const count = std::min(run.count - offset,
+                                           interval - num_moves % interval);
+      warehouse.move(MoveRun{run.move, count});
+      offset += count;
+      num_moves += count;
+      if (num_moves % interval == 0) {
+        checkpoints.push_back(
+            warehouse.checkpoint({num_moves, run_idx, offset}));
+      }
     }
   }
+  return checkpoints;
 }
 
+/// puts the warehouse in the state it has after the first `num_moves` moves,
+/// replaying from the latest checkpoint before that; this is what allows
+/// resuming a long run, or bisecting it for the first move with some property
 void
-move_up(Robot &robot, Matrix<char> &grid) {
-  // search for a space moving up
-  // if we find a block, no movement is done
-  auto row = robot.y - 1;
-  auto col = robot.x;
-  while (grid(row, col) == 'O') {
-    --row;
+replay_until(Warehouse &warehouse,
+             std::vector<MoveRun> const &runs,
+             std::vector<Checkpoint> const &checkpoints,
+             std::uint64_t num_moves) {
+  auto found = std::ranges::upper_bound(
+      checkpoints, num_moves, {}, [](Checkpoint const &checkpoint) {
+        return checkpoint.position.num_moves;
+      });
+  ASSERT(found != checkpoints.begin());
+  Checkpoint const &start = *std::prev(found);
+  warehouse.restore(start);
+
+  std::uint64_t remaining = num_moves - start.position.num_moves;
+  std::uint64_t offset = start.position.run_offset;
+  for (std::size_t run_idx = start.position.run_idx;
+       remaining != 0 && run_idx < runs.size();
+       ++run_idx) {
+    std::uint64_t const count = std::min(runs[run_idx].count - offset,
+                                         remaining);
+    warehouse.move(MoveRun{runs[run_idx].move, count});
+    remaining -= count;
+    offset = 0;
   }
-  // if we found a block, no movement can be done
-  if (grid(row, col) == '#') {
-    return;
+}
+
+std::pair<std::uint64_t, std::uint64_t>
+next_cell(std::uint64_t x, std::uint64_t y, Move move) {
+  switch (move) {
+  case Move::UP: {
+    return {x, y - 1};
   }
-  // we found a space
-  ASSERT(grid(row, col) == ' ');
-  while (row != robot.y - 1) {
-    grid(row, col) = 'O';
-    ++row;
+  case Move::DOWN: {
+    return {x, y + 1};
   }
-  grid(row, col) = ' ';
-  robot.y = row;
-}
-void
-move_down(Robot &robot, Matrix<char> &grid) {
-  // search for a space moving down
-  // if we find a block, no movement is done
-  auto row = robot.y + 1;
-  auto col = robot.x;
-  while (grid(row, col) == 'O') {
-    ++row;
+  case Move::LEFT: {
+    return {x - 1, y};
   }
-  // if we found a block, no movement can be done
-  if (grid(row, col) == '#') {
-    return;
+  case Move::RIGHT: {
+    return {x + 1, y};
   }
-  // we found a space
-  ASSERT(grid(row, col) == ' ');
-  while (row != robot.y + 1) {
-    grid(row, col) = 'O';
-    --row;
   }
-  grid(row, col) = ' ';
-  robot.y = row;
+  UNREACHABLE(move);
+}
+
+std::uint64_t
+gps_coord(Item const &item) {
+  return item.is_block ? 0 : item.y * 100 + item.x;
+}
+
+Warehouse::Warehouse(std::size_t rows,
+                     std::size_t cols,
+                     Robot robot,
+                     std::vector<Item> items)
+    : m_robot(robot),
+      m_items(std::move(items)),
+      m_occupancy(rows, cols, NO_ITEM),
+      m_visited(m_items.size()) {
+  ASSERT(m_items.size() < NO_ITEM);
+  place_all();
+  m_gps_sum = std::ranges::fold_left(
+      m_items, 0ULL, [](std::uint64_t prev, Item const &item) {
+        return prev + gps_coord(item);
+      });
 }
+
 void
-move_left(Robot &robot, Matrix<char> &grid) {
-  // search for a space moving left
-  // if we find a block, no movement is done
-  auto row = robot.y;
-  auto col = robot.x - 1;
-  while (grid(row, col) == 'O') {
-    --col;
-  }
-  // if we found a block, no movement can be done
-  if (grid(row, col) == '#') {
-    return;
-  }
-  // we found a space
-  ASSERT(grid(row, col) == ' ');
-  while (col != robot.x - 1) {
-    grid(row, col) = 'O';
-    ++col;
+Warehouse::place(std::uint32_t id, std::uint32_t value) {
+  Item const &item = m_items[id];
+  for (std::size_t dx{}; dx < BOX_WIDTH; ++dx) {
+    m_occupancy(item.y, item.x + dx) = value;
   }
-  grid(row, col) = ' ';
-  robot.x = col;
 }
+
 void
-move_right(Robot &robot, Matrix<char> &grid) {
-  // search for a space moving right
-  // if we find a block, no movement is done
-  auto row = robot.y;
-  auto col = robot.x + 1;
-  while (grid(row, col) == 'O') {
-    ++col;
+Warehouse::place_all() {
+  m_occupancy.clear(NO_ITEM);
+  for (std::size_t id{}; id < m_items.size(); ++id) {
+    place(static_cast<std::uint32_t>(id), static_cast<std::uint32_t>(id));
   }
-  // if we found a block, no movement can be done
-  if (grid(row, col) == '#') {
-    return;
+}
+
+/// returns false if the robot was blocked and nothing moved
+bool
+Warehouse::move(Move move) {
+  auto [x, y] = next_cell(m_robot.x, m_robot.y, move);
+  std::uint32_t const first = m_occupancy(y, x);
+  if (first != NO_ITEM && !push(first, move)) {
+    return false;
   }
-  // we found a space
-  ASSERT(grid(row, col) == ' ');
-  while (col != robot.x + 1) {
-    grid(row, col) = 'O';
-    --col;
+  m_robot = Robot{x, y};
+  return true;
+}
+
+/// once the robot is blocked, it stays blocked for the rest of the run, since
+/// nothing in the warehouse changed
+void
+Warehouse::move(MoveRun const &run) {
+  for (std::uint64_t idx{}; idx < run.count; ++idx) {
+    if (!move(run.move)) {
+      return;
+    }
   }
-  grid(row, col) = ' ';
-  robot.x = col;
 }
 
-std::uint64_t
-sum_of_gps_coord(Matrix<char> const &grid) {
-  std::uint64_t total{};
-  for (std::size_t row{}; row < grid.rows(); ++row) {
-    for (std::size_t col{}; col < grid.cols(); ++col) {
-      if (grid(row, col) == 'O') {
-        total += 100 * row + col;
+/// a breadth-first visit of the items in the way, starting from the one next
+/// to the robot; the items only need to be looked up in the cells in front of
+/// them, so the cost is proportional to the number of items pushed
+bool
+Warehouse::push(std::uint32_t first, Move move) {
+  ++m_num_pushes;
+  m_to_move.clear();
+  m_to_move.push_back(first);
+  m_visited[first] = m_num_pushes;
+
+  for (std::size_t idx{}; idx < m_to_move.size(); ++idx) {
+    std::uint32_t const id = m_to_move[idx];
+    Item const &item = m_items[id];
+    if (item.is_block) {
+      // no movement is possible
+      return false;
+    }
+    for (std::uint64_t dx{}; dx < BOX_WIDTH; ++dx) {
+      auto [x, y] = next_cell(item.x + dx, item.y, move);
+      std::uint32_t const other = m_occupancy(y, x);
+      if (other != NO_ITEM && other != id && m_visited[other] != m_num_pushes) {
+        m_visited[other] = m_num_pushes;
+        m_to_move.push_back(other);
       }
     }
   }
-  return total;
+
+  // lift all the items before putting them down again, so that an item
+  // doesn't overwrite the cells another one is moving into
+  for (std::uint32_t id : m_to_move) {
+    place(id, NO_ITEM);
+  }
+  for (std::uint32_t id : m_to_move) {
+    Item &item = m_items[id];
+    m_gps_sum -= gps_coord(item);
+    std::tie(item.x, item.y) = next_cell(item.x, item.y, move);
+    m_gps_sum += gps_coord(item);
+    place(id, id);
+  }
+  return true;
+}
+
+Checkpoint
+Warehouse::checkpoint(MovePosition const &position) const {
+  return {position, m_robot, m_items, m_gps_sum};
+}
+
+void
+Warehouse::restore(Checkpoint const &checkpoint) {
+  ASSERT(checkpoint.items.size() == m_items.size());
+  m_robot = checkpoint.robot;
+  m_items = checkpoint.items;
+  m_gps_sum = checkpoint.gps_sum;
+  place_all();
+}
+
+std::uint32_t
+Warehouse::item_at(std::uint64_t x, std::uint64_t y) const {
+  return m_occupancy(y, x);
+}
+
+Robot const &
+Warehouse::robot() const {
+  return m_robot;
+}
+
+std::uint64_t
+Warehouse::sum_of_gps_coord() const {
+  return m_gps_sum;
 }
 } // namespace
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <array>
 #include <cstdint>
 #include <fmt/core.h>
@@ -8,6 +9,7 @@
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
 
 #include "matrix.hpp"
 
@@ -17,49 +19,19 @@ struct Robot
   std::uint64_t y;
 };
 
+/// a wall or a box; both are two cells wide, starting at (x, y)
 struct Item
 {
   bool is_block;
   std::uint64_t x;
   std::uint64_t y;
-
-  [[nodiscard]] bool
-  is_above(Item const &other) const {
-    return y + 1 == other.y
-           && (x == other.x || x + 1 == other.x || x == other.x + 1);
-  }
-  [[nodiscard]] bool
-  is_below(Item const &other) const {
-    return y == other.y + 1
-           && (x == other.x || x + 1 == other.x || x == other.x + 1);
-  }
-  [[nodiscard]] bool
-  is_left_of(Item const &other) const {
-    return y == other.y && x + 2 == other.x;
-  }
-  [[nodiscard]] bool
-  is_right_of(Item const &other) const {
-    return y == other.y && x == other.x + 2;
-  }
-
-  [[nodiscard]] bool
-  is_above(Robot const &robot) const {
-    return y + 1 == robot.y && (x == robot.x || x + 1 == robot.x);
-  }
-  [[nodiscard]] bool
-  is_below(Robot const &robot) const {
-    return y == robot.y + 1 && (x == robot.x || x + 1 == robot.x);
-  }
-  [[nodiscard]] bool
-  is_left_of(Robot const &robot) const {
-    return y == robot.y && x + 2 == robot.x;
-  }
-  [[nodiscard]] bool
-  is_right_of(Robot const &robot) const {
-    return y == robot.y && x == robot.x + 1;
-  }
 };
 
+/// marks the cells of the occupancy grid that no item covers
+static constexpr std::uint32_t NO_ITEM{~std::uint32_t{}};
+/// the number of cells covered by every wall and box
+static constexpr std::size_t BOX_WIDTH{2};
+
 enum class Move
 {
   UP,
@@ -68,30 +40,100 @@ enum class Move
   RIGHT,
 };
 
+/// `count` consecutive copies of the same move
+struct MoveRun
+{
+  Move move;
+  std::uint64_t count;
+};
+
+/// a point in a stream of move runs: the first `num_moves` moves, made of the
+/// first `run_idx` runs plus `run_offset` moves of the next one
+struct MovePosition
+{
+  std::uint64_t num_moves;
+  std::size_t run_idx;
+  std::uint64_t run_offset;
+};
+
+/// everything needed to resume a warehouse from a position in its moves
+struct Checkpoint
+{
+  MovePosition position;
+  Robot robot;
+  std::vector<Item> items;
+  std::uint64_t gps_sum;
+};
+
 namespace
 {
 void
 tests();
+/// the robot and the items of a warehouse, whose walls and boxes are
+/// `BOX_WIDTH` cells wide; every cell of the grid records the id of the item
+/// covering it, so a push only ever looks at the cells right in front of the
+/// items it moves
+class Warehouse
+{
+private:
+  Robot m_robot;
+  std::vector<Item> m_items;
+  Matrix<std::uint32_t> m_occupancy;
+  /// `m_visited[id] == m_num_pushes` if the current push has already reached
+  /// the item; bumping the counter resets all the marks at once
+  std::vector<std::uint64_t> m_visited;
+  std::uint64_t m_num_pushes{};
+  /// the items taking part in the current push, reused between moves
+  std::vector<std::uint32_t> m_to_move;
+  /// kept up to date by every push, instead of summing all the boxes at the end
+  std::uint64_t m_gps_sum{};
+
+  bool
+  push(std::uint32_t first, Move move);
+  void
+  place(std::uint32_t id, std::uint32_t value);
+  void
+  place_all();
+
+public:
+  Warehouse(std::size_t rows,
+            std::size_t cols,
+            Robot robot,
+            std::vector<Item> items);
+
+  bool
+  move(Move move);
+  void
+  move(MoveRun const &run);
+  [[nodiscard]] Checkpoint
+  checkpoint(MovePosition const &position) const;
+  void
+  restore(Checkpoint const &checkpoint);
+  [[nodiscard]] std::uint32_t
+  item_at(std::uint64_t x, std::uint64_t y) const;
+  [[nodiscard]] Robot const &
+  robot() const;
+  [[nodiscard]] std::uint64_t
+  sum_of_gps_coord() const;
+};
+
 std::uint64_t
 sum_of_gps_coord(std::ranges::range auto &&lines);
-std::tuple<Robot, std::vector<Move>, std::vector<Item>>
-parse_robot_moves_items(std::ranges::range auto &&lines);
+std::tuple<Warehouse, std::vector<MoveRun>>
+parse_warehouse_moves(std::ranges::range auto &&lines);
+std::vector<Checkpoint>
+perform_movements(Warehouse &warehouse,
+                  std::vector<MoveRun> const &runs,
+                  std::uint64_t interval);
 void
-perform_movements(Robot &robot,
-                  std::vector<Move> const &moves,
-                  std::vector<Item> &items);
-void
-move_up(Robot &robot, std::vector<Item> &items);
-void
-move_down(Robot &robot, std::vector<Item> &items);
-void
-move_left(Robot &robot, std::vector<Item> &items);
-void
-move_right(Robot &robot, std::vector<Item> &items);
+replay_until(Warehouse &warehouse,
+             std::vector<MoveRun> const &runs,
+             std::vector<Checkpoint> const &checkpoints,
+             std::uint64_t num_moves);
+std::pair<std::uint64_t, std::uint64_t>
+next_cell(std::uint64_t x, std::uint64_t y, Move move);
 std::uint64_t
-compute_sum_of_gps_coord(std::vector<Item> const &items);
-void
-print_grid(std::vector<Item> const &items, Robot const &robot);
+gps_coord(Item const &item);
 } // namespace
 
 int
@@ -123,18 +165,45 @@ namespace
 {
 void
 tests() {
+  using namespace std::literals::string_view_literals;
   {
-    Item it1{false, 6, 3};
-    Item it2{false, 8, 3};
-    Item it3{false, 6, 4};
-    Item it4{false, 7, 4};
-    ASSERT(it3.is_below(it1));
-    ASSERT(!it3.is_below(it2));
-    ASSERT(it4.is_below(it1));
-    ASSERT(it4.is_below(it2));
+    auto const lines = std::array{
+        "#######"sv,
+        "#...#.#"sv,
+        "#.....#"sv,
+        "#..OO@#"sv,
+        "#..O..#"sv,
+        "#.....#"sv,
+        "#######"sv,
+        ""sv,
+        "<"sv,
+    };
+    auto [warehouse, runs] = parse_warehouse_moves(lines);
+    // both cells of a box map to the same item
+    ASSERT(warehouse.item_at(6, 3) == warehouse.item_at(7, 3));
+    ASSERT(warehouse.item_at(7, 3) != warehouse.item_at(8, 3));
+    ASSERT(warehouse.item_at(10, 3) == NO_ITEM);
+
+    std::uint32_t const left_box = warehouse.item_at(6, 3);
+    warehouse.move(Move::LEFT);
+    ASSERT(warehouse.robot().x == 9);
+    ASSERT(warehouse.item_at(5, 3) == left_box);
+    ASSERT(warehouse.item_at(7, 3) != left_box);
+    ASSERT(warehouse.item_at(9, 3) == NO_ITEM);
+
+    // pushing up the box below moves both boxes half above it
+    std::uint32_t const lower_box = warehouse.item_at(6, 4);
+    std::uint32_t const right_box = warehouse.item_at(7, 3);
+    for (Move move : {Move::DOWN, Move::DOWN, Move::LEFT, Move::LEFT}) {
+      warehouse.move(move);
+    }
+    warehouse.move(Move::UP);
+    ASSERT(warehouse.robot().x == 7 && warehouse.robot().y == 4);
+    ASSERT(warehouse.item_at(6, 3) == lower_box);
+    ASSERT(warehouse.item_at(5, 2) == left_box);
+    ASSERT(warehouse.item_at(8, 2) == right_box);
+    ASSERT(warehouse.item_at(6, 4) == NO_ITEM);
   }
-
-  using namespace std::literals::string_view_literals;
   {
     auto const lines = std::array{
         "#######"sv,
@@ -190,17 +259,56 @@ tests() {
     };
     ASSERT(sum_of_gps_coord(lines) == 9021);
   }
+  {
+    auto const lines = std::array{
+        "########"sv,
+        "#..O.O.#"sv,
+        "##@.O..#"sv,
+        "#...O..#"sv,
+        "#.#.O..#"sv,
+        "#...O..#"sv,
+        "#......#"sv,
+        "########"sv,
+        ""sv,
+        "<^^>>>vv<v>>v<<"sv,
+    };
+    auto [warehouse, runs] = parse_warehouse_moves(lines);
+    // consecutive copies of a move are read as a single run
+    ASSERT(runs.size() == 9);
+    ASSERT(runs[1].move == Move::UP && runs[1].count == 2);
+    ASSERT(runs[2].move == Move::RIGHT && runs[2].count == 3);
+
+    // replaying from any checkpoint must agree with running straight through
+    auto const checkpoints = perform_movements(warehouse, runs, 4);
+    ASSERT(checkpoints.size() == 4);
+    for (std::uint64_t num_moves{}; num_moves <= 15; ++num_moves) {
+      auto [expected, expected_runs] = parse_warehouse_moves(lines);
+      std::uint64_t remaining = num_moves;
+      for (auto const &[move, count] : expected_runs) {
+        for (std::uint64_t idx{}; idx < count && remaining != 0; ++idx) {
+          expected.move(move);
+          --remaining;
+        }
+      }
+      replay_until(warehouse, runs, checkpoints, num_moves);
+      ASSERT(warehouse.sum_of_gps_coord() == expected.sum_of_gps_coord());
+      ASSERT(warehouse.robot().x == expected.robot().x);
+      ASSERT(warehouse.robot().y == expected.robot().y);
+    }
+  }
 }
 
 std::uint64_t
 sum_of_gps_coord(std::ranges::range auto &&lines) {
-  auto [robot, moves, items] = parse_robot_moves_items(lines);
-  perform_movements(robot, moves, items);
-  return compute_sum_of_gps_coord(items);
+  auto [warehouse, runs] = parse_warehouse_moves(lines);
+  for (MoveRun const &run : runs) {
+    warehouse.move(run);
+  }
+  return warehouse.sum_of_gps_coord();
 }
 
-std::tuple<Robot, std::vector<Move>, std::vector<Item>>
-parse_robot_moves_items(std::ranges::range auto &&lines) {
+std::tuple<Warehouse, std::vector<MoveRun>>
+parse_warehouse_moves(std::ranges::range auto &&lines) {
   // find the number of rows in the grid
   auto const rows = static_cast<std::size_t>(
       std::distance(lines.begin(), std::ranges::find(lines, "")));
@@ -213,15 +321,15 @@ parse_robot_moves_items(std::ranges::range auto &&lines) {
       auto ch = lines[row][col];
       switch (ch) {
       case '#': {
-        items.emplace_back(true, col * 2, row);
+        items.emplace_back(true, col * BOX_WIDTH, row);
         break;
       }
       case 'O': {
-        items.emplace_back(false, col * 2, row);
+        items.emplace_back(false, col * BOX_WIDTH, row);
         break;
       }
       case '@': {
-        robot = Robot{col * 2, row};
+        robot = Robot{col * BOX_WIDTH, row};
         break;
       }
       case '.': {
@@ -234,237 +342,243 @@ parse_robot_moves_items(std::ranges::range auto &&lines) {
     }
   }
 
-  std::vector<Move> moves;
+  std::vector<MoveRun> runs;
   for (auto const &line : lines | std::views::drop(rows + 1)) {
-    std::ranges::transform(line, std::back_inserter(moves), [](char ch) {
+    for (char ch : line) {
+      Move move{};
       switch (ch) {
       case '^': {
-        return Move::UP;
+        move = Move::UP;
+        break;
       }
       case 'v': {
-        return Move::DOWN;
+        move = Move::DOWN;
+        break;
       }
       case '<': {
-        return Move::LEFT;
+        move = Move::LEFT;
+        break;
       }
       case '>': {
-        return Move::RIGHT;
+        move = Move::RIGHT;
+        break;
       }
       default: {
         UNREACHABLE(ch);
       }
       }
-    });
+      if (!runs.empty() && runs.back().move == move) {
+        ++runs.back().count;
+      } else {
+        runs.emplace_back(move, 1);
+      }
+    }
   }
-  return {robot, moves, items};
+  return {Warehouse(rows, cols * BOX_WIDTH, robot, std::move(items)), runs};
 }
 
-void
-perform_movements(Robot &robot,
-                  std::vector<Move> const &moves,
-                  std::vector<Item> &items) {
-  for (Move const &move : moves) {
-    switch (move) {
-    case Move::UP: {
-      move_up(robot, items);
-      break;
-    }
-    case Move::DOWN: {
-      move_down(robot, items);
-      break;
-    }
-    case Move::LEFT: {
-      move_left(robot, items);
-      break;
-    }
-    case Move::RIGHT: {
-      move_right(robot, items);
-      break;
-    }
+/// runs all the moves, taking a checkpoint at the start and then every
+/// `interval` moves; a run that straddles a checkpoint is split around it
+std::vector<Checkpoint>
+perform_movements(Warehouse &warehouse,
+                  std::vector<MoveRun> const &runs,
+                  std::uint64_t interval) {
+  ASSERT(interval > 0);
+  std::vector<Checkpoint> checkpoints{warehouse.checkpoint({0, 0, 0})};
+  std::uint64_t num_moves{};
+  for (std::size_t run_idx{}; run_idx < runs.size(); ++run_idx) {
+    MoveRun const &run = runs[run_idx];
+    for (std::uint64_t offset{}; offset < run.count;) {
+      std::uint64_t const count = std::min(run.count - offset,
+                                           interval - num_moves % interval);
+      warehouse.move(MoveRun{run.move, count});
+      offset += count;
+      num_moves += count;
+      if (num_moves % interval == 0) {
+        checkpoints.push_back(
+            warehouse.checkpoint({num_moves, run_idx, offset}));
+      }
     }
   }
-  print_grid(items, robot);
+  return checkpoints;
 }
 
+/// puts the warehouse in the state it has after the first `num_moves` moves,
+/// replaying from the latest checkpoint before that; this is what allows
+/// resuming a long run, or bisecting it for the first move with some property
 void
-move_up(Robot &robot, std::vector<Item> &items) {
-  auto find_it = std::ranges::find_if(items, [&robot](Item const &item) {
-    return item.is_above(robot);
-  });
-  if (find_it == items.end()) {
-    // nothing was above the robot
-    --robot.y;
-    return;
+replay_until(Warehouse &warehouse,
+             std::vector<MoveRun> const &runs,
+             std::vector<Checkpoint> const &checkpoints,
+             std::uint64_t num_moves) {
+  auto found = std::ranges::upper_bound(
+      checkpoints, num_moves, {}, [](Checkpoint const &checkpoint) {
+        return checkpoint.position.num_moves;
+      });
+  ASSERT(found != checkpoints.begin());
+  Checkpoint const &start = *std::prev(found);
+  warehouse.restore(start);
+
+  std::uint64_t remaining = num_moves - start.position.num_moves;
+  std::uint64_t offset = start.position.run_offset;
+  for (std::size_t run_idx = start.position.run_idx;
+       remaining != 0 && run_idx < runs.size();
+       ++run_idx) {
+    std::uint64_t const count = std::min(runs[run_idx].count - offset,
+                                         remaining);
+    warehouse.move(MoveRun{runs[run_idx].move, count});
+    remaining -= count;
+    offset = 0;
   }
+}
 
-  std::vector<Item *> to_move;
-  std::vector<Item *> to_explore;
-
-  to_explore.emplace_back(&*find_it);
-  while (!to_explore.empty()) {
-    Item &exp_item = *to_explore.back();
-    to_explore.pop_back();
-    if (exp_item.is_block) {
-      // no movement is possible
-      return;
-    }
-
-    for (Item &item : items) {
-      if (item.is_above(exp_item)) {
-        to_explore.emplace_back(&item);
-      }
-    }
-    to_move.emplace_back(&exp_item);
+std::pair<std::uint64_t, std::uint64_t>
+next_cell(std::uint64_t x, std::uint64_t y, Move move) {
+  switch (move) {
+  case Move::UP: {
+    return {x, y - 1};
   }
-
-  for (Item *item : to_move) {
-    --item->y;
+  case Move::DOWN: {
+    return {x, y + 1};
   }
-  --robot.y;
-}
-void
-move_down(Robot &robot, std::vector<Item> &items) {
-  auto find_it = std::ranges::find_if(items, [&robot](Item const &item) {
-    return item.is_below(robot);
-  });
-  if (find_it == items.end()) {
-    // nothing was above the robot
-    ++robot.y;
-    return;
+  case Move::LEFT: {
+    return {x - 1, y};
   }
+  case Move::RIGHT: {
+    return {x + 1, y};
+  }
+  }
+  UNREACHABLE(move);
+}
 
-  std::vector<Item *> to_move;
-  std::vector<Item *> to_explore;
-
-  to_explore.emplace_back(&*find_it);
-  while (!to_explore.empty()) {
-    Item &exp_item = *to_explore.back();
-    to_explore.pop_back();
-    if (exp_item.is_block) {
-      // no movement is possible
-      return;
-    }
+std::uint64_t
+gps_coord(Item const &item) {
+  return item.is_block ? 0 : item.y * 100 + item.x;
+}
 
-    for (Item &item : items) {
-      if (item.is_below(exp_item)) {
-        to_explore.emplace_back(&item);
-      }
-    }
-    to_move.emplace_back(&exp_item);
-  }
+Warehouse::Warehouse(std::size_t rows,
+                     std::size_t cols,
+                     Robot robot,
+                     std::vector<Item> items)
+    : m_robot(robot),
+      m_items(std::move(items)),
+      m_occupancy(rows, cols, NO_ITEM),
+      m_visited(m_items.size()) {
+  ASSERT(m_items.size() < NO_ITEM);
+  place_all();
+  m_gps_sum = std::ranges::fold_left(
+      m_items, 0ULL, [](std::uint64_t prev, Item const &item) {
+        return prev + gps_coord(item);
+      });
+}
 
-  for (Item *item : to_move) {
-    ++item->y;
+void
+Warehouse::place(std::uint32_t id, std::uint32_t value) {
+  Item const &item = m_items[id];
+  for (std::size_t dx{}; dx < BOX_WIDTH; ++dx) {
+    m_occupancy(item.y, item.x + dx) = value;
   }
-  ++robot.y;
 }
+
 void
-move_left(Robot &robot, std::vector<Item> &items) {
-  auto find_it = std::ranges::find_if(items, [&robot](Item const &item) {
-    return item.is_left_of(robot);
-  });
-  if (find_it == items.end()) {
-    // nothing was above the robot
-    --robot.x;
-    return;
+Warehouse::place_all() {
+  m_occupancy.clear(NO_ITEM);
+  for (std::size_t id{}; id < m_items.size(); ++id) {
+    place(static_cast<std::uint32_t>(id), static_cast<std::uint32_t>(id));
   }
+}
 
-  std::vector<Item *> to_move;
-  std::vector<Item *> to_explore;
+/// returns false if the robot was blocked and nothing moved
+bool
+Warehouse::move(Move move) {
+  auto [x, y] = next_cell(m_robot.x, m_robot.y, move);
+  std::uint32_t const first = m_occupancy(y, x);
+  if (first != NO_ITEM && !push(first, move)) {
+    return false;
+  }
+  m_robot = Robot{x, y};
+  return true;
+}
 
-  to_explore.emplace_back(&*find_it);
-  while (!to_explore.empty()) {
-    Item &exp_item = *to_explore.back();
-    to_explore.pop_back();
-    if (exp_item.is_block) {
-      // no movement is possible
+/// once the robot is blocked, it stays blocked for the rest of the run, since
+/// nothing in the warehouse changed
+void
+Warehouse::move(MoveRun const &run) {
+  for (std::uint64_t idx{}; idx < run.count; ++idx) {
+    if (!move(run.move)) {
       return;
     }
-
-    auto find_item = std::ranges::find_if(items, [&exp_item](Item const &item) {
-      return item.is_left_of(exp_item);
-    });
-    if (find_item != items.end()) {
-      to_explore.emplace_back(&*find_item);
-    }
-    to_move.emplace_back(&exp_item);
   }
-
-  for (Item *item : to_move) {
-    --item->x;
-  }
-  --robot.x;
 }
-void
-move_right(Robot &robot, std::vector<Item> &items) {
-  auto find_it = std::ranges::find_if(items, [&robot](Item const &item) {
-    return item.is_right_of(robot);
-  });
-  if (find_it == items.end()) {
-    // nothing was above the robot
-    ++robot.x;
-    return;
-  }
-
-  std::vector<Item *> to_move;
-  std::vector<Item *> to_explore;
 
-  to_explore.emplace_back(&*find_it);
-  while (!to_explore.empty()) {
-    Item &exp_item = *to_explore.back();
-    to_explore.pop_back();
-    if (exp_item.is_block) {
+/// a breadth-first visit of the items in the way, starting from the one next
+/// to the robot; the items only need to be looked up in the cells in front of
+/// them, so the cost is proportional to the number of items pushed
+bool
+Warehouse::push(std::uint32_t first, Move move) {
+  ++m_num_pushes;
+  m_to_move.clear();
+  m_to_move.push_back(first);
+  m_visited[first] = m_num_pushes;
+
+  for (std::size_t idx{}; idx < m_to_move.size(); ++idx) {
+    std::uint32_t const id = m_to_move[idx];
+    Item const &item = m_items[id];
+    if (item.is_block) {
       // no movement is possible
-      return;
+      return false;
     }
-
-    auto find_item = std::ranges::find_if(items, [&exp_item](Item const &item) {
-      return item.is_right_of(exp_item);
-    });
-    if (find_item != items.end()) {
-      to_explore.emplace_back(&*find_item);
+    for (std::uint64_t dx{}; dx < BOX_WIDTH; ++dx) {
+      auto [x, y] = next_cell(item.x + dx, item.y, move);
+      std::uint32_t const other = m_occupancy(y, x);
+      if (other != NO_ITEM && other != id && m_visited[other] != m_num_pushes) {
+        m_visited[other] = m_num_pushes;
+        m_to_move.push_back(other);
+      }
     }
-    to_move.emplace_back(&exp_item);
   }
 
-  for (Item *item : to_move) {
-    ++item->x;
+  // lift all the items before putting them down again, so that an item
+  // doesn't overwrite the cells another one is moving into
+  for (std::uint32_t id : m_to_move) {
+    place(id, NO_ITEM);
   }
-  ++robot.x;
+  for (std::uint32_t id : m_to_move) {
+    Item &item = m_items[id];
+    m_gps_sum -= gps_coord(item);
+    std::tie(item.x, item.y) = next_cell(item.x, item.y, move);
+    m_gps_sum += gps_coord(item);
+    place(id, id);
+  }
+  return true;
 }
 
-std::uint64_t
-compute_sum_of_gps_coord(std::vector<Item> const &items) {
-  return std::ranges::fold_left(items, 0, [](std::uint64_t prev, Item const &item) {
-    return prev + (item.is_block ? 0 : item.y * 100 + item.x);
-  });
+Checkpoint
+Warehouse::checkpoint(MovePosition const &position) const {
+  return {position, m_robot, m_items, m_gps_sum};
 }
 
 void
-print_grid(std::vector<Item> const &items, Robot const &robot) {
-  std::size_t max_row =
-      std::ranges::max_element(items, [](Item const &lhs, Item const &rhs) {
-        return lhs.y < rhs.y;
-      })->y;
-  std::size_t max_col =
-      std::ranges::max_element(items, [](Item const &lhs, Item const &rhs) {
-        return lhs.x < rhs.x;
-      })->x;
-
-  Matrix<char> grid(max_row + 1, max_col + 2, ' ');
-  for (Item const &item : items) {
-    if (item.is_block) {
-      grid(item.y, item.x) = '#';
-      grid(item.y, item.x + 1) = '#';
-    } else {
-      grid(item.y, item.x) = '[';
-      grid(item.y, item.x + 1) = ']';
-    }
-  }
+Warehouse::restore(Checkpoint const &checkpoint) {
+  ASSERT(checkpoint.items.size() == m_items.size());
+  m_robot = checkpoint.robot;
+  m_items = checkpoint.items;
+  m_gps_sum = checkpoint.gps_sum;
+  place_all();
+}
 
-  grid(robot.y, robot.x) = '@';
+std::uint32_t
+Warehouse::item_at(std::uint64_t x, std::uint64_t y) const {
+  return m_occupancy(y, x);
+}
 
-  grid.print();
+Robot const &
+Warehouse::robot() const {
+  return m_robot;
 }
 
+std::uint64_t
+Warehouse::sum_of_gps_coord() const {
+  return m_gps_sum;
+}
 } // namespace
@@ -2,154 +2,253 @@
 #include <array>
 #include <cstdint>
 #include <fmt/core.h>
+#include <fmt/ranges.h> // fmt::join
 #include <fstream>
 #include <libassert/assert.hpp>
 #include <ranges>
 #include <scn/scan.h>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
 
+enum class Opcode : std::uint8_t
+{
+  adv,
+  bxl,
+  bst,
+  jnz,
+  bxc,
+  out,
+  bdv,
+  cdv,
+  /// an instruction whose combo operand is 7; only an error if it is executed
+  invalid,
+};
+
+/// a pre-decoded instruction; for the instructions that take a combo operand,
+/// `operand` is already the index of its value in the register file
+struct Instruction
+{
+  Opcode opcode;
+  std::uint8_t operand;
+};
+
+/// combo operands 0-3 are literals and 4-6 are the registers A, B and C, so a
+/// register file that starts with the literals resolves every combo operand
+/// with a plain array access
+static constexpr std::size_t REG_A{4};
+static constexpr std::size_t REG_B{5};
+static constexpr std::size_t REG_C{6};
+using Registers = std::array<std::uint64_t, 7>;
+
+/// `val >> shift`, but well-defined for shifts past the width of the type
+constexpr std::uint64_t
+shift_right(std::uint64_t val, std::uint64_t shift) {
+  return shift >= 64 ? 0 : val >> shift;
+}
+
 struct Computer
 {
-  std::uint64_t m_rega{};
-  std::uint64_t m_regb{};
-  std::uint64_t m_regc{};
+  Registers m_registers{0, 1, 2, 3};
   std::vector<std::uint64_t> m_program;
+  /// one decoded instruction per program counter, so that jumps to odd
+  /// addresses still land on a valid instruction
+  std::vector<Instruction> m_code;
+  /// set if the program is a single `... adv 3 ... jnz 0` loop, whose body can
+  /// be run straight through without checking for jumps
+  bool m_is_canonical_loop{};
+  /// the instructions of the canonical loop, one per instruction instead of
+  /// one per program counter, ending with its `jnz 0`
+  std::vector<Instruction> m_loop_body;
 
-  std::uint64_t m_pc{};
-  std::vector<std::uint64_t> m_output;
+  std::vector<std::uint8_t> m_output;
 
   Computer(std::size_t rega,
            std::size_t regb,
            std::size_t regc,
            std::vector<std::uint64_t> program)
-      : m_rega(rega),
-        m_regb(regb),
-        m_regc(regc),
-        m_program(std::move(program)) {}
-
-  [[nodiscard]] std::uint64_t
-  combo_op(std::size_t op) const {
-    switch (op) {
-    case 0:
-    case 1:
-    case 2:
-    case 3: {
-      return op;
-    }
-    case 4: {
-      return m_rega;
-    }
-    case 5: {
-      return m_regb;
-    }
-    case 6: {
-      return m_regc;
+      : m_program(std::move(program)) {
+    m_registers[REG_A] = rega;
+    m_registers[REG_B] = regb;
+    m_registers[REG_C] = regc;
+    decode();
+    m_output.reserve(m_program.size());
+  }
+
+  void
+  decode() {
+    std::size_t const num_addresses = m_program.empty() ? 0
+                                                        : m_program.size() - 1;
+    m_code.clear();
+    for (std::size_t pc{}; pc < num_addresses; ++pc) {
+      auto opcode = static_cast<Opcode>(m_program[pc]);
+      auto operand = static_cast<std::uint8_t>(m_program[pc + 1]);
+      bool takes_combo = opcode == Opcode::adv || opcode == Opcode::bst
+                         || opcode == Opcode::out || opcode == Opcode::bdv
+                         || opcode == Opcode::cdv;
+      if (m_program[pc] > 7 || (takes_combo && operand > REG_C)) {
+        opcode = Opcode::invalid;
+      }
+      m_code.push_back({opcode, operand});
     }
-    default: {
-      UNREACHABLE(op);
+
+    std::size_t num_adv3{};
+    std::size_t num_jnz{};
+    for (std::size_t pc{}; pc < m_code.size(); pc += 2) {
+      num_adv3 += m_code[pc].opcode == Opcode::adv && m_code[pc].operand == 3;
+      num_jnz += m_code[pc].opcode == Opcode::jnz;
     }
+    m_is_canonical_loop = m_program.size() % 2 == 0 && !m_code.empty()
+                          && m_code.back().opcode == Opcode::jnz
+                          && m_code.back().operand == 0 && num_adv3 == 1
+                          && num_jnz == 1;
+
+    m_loop_body.clear();
+    if (m_is_canonical_loop) {
+      for (std::size_t pc{}; pc < m_code.size(); pc += 2) {
+        m_loop_body.push_back(m_code[pc]);
+      }
     }
   }
 
-  void
-  adv(std::size_t op) {
-    m_rega = m_rega / (1LU << combo_op(op));
-    m_pc += 2;
-  }
+  /// runs the program from scratch with the given registers; the output
+  /// buffer is reused between runs, so this doesn't allocate once warmed up
+  std::span<std::uint8_t const>
+  execute(std::uint64_t rega, std::uint64_t regb, std::uint64_t regc) {
+    Registers regs = m_registers;
+    regs[REG_A] = rega;
+    regs[REG_B] = regb;
+    regs[REG_C] = regc;
+    m_output.clear();
 
-  void
-  bxl(std::size_t op) {
-    m_regb = m_regb ^ op;
-    m_pc += 2;
+    if (m_is_canonical_loop) {
+      execute_loop(regs);
+    } else {
+      execute_threaded(regs);
+    }
+    return m_output;
   }
 
+  /// direct-threaded dispatch: every handler jumps straight to the handler of
+  /// the next instruction, instead of going back through a central switch
   void
-  bst(std::size_t op) {
-    m_regb = combo_op(op) & 0b111;
-    m_pc += 2;
-  }
+  execute_threaded(Registers &regs) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static void *const handlers[] = {
+        &&adv, &&bxl, &&bst, &&jnz, &&bxc, &&out, &&bdv, &&cdv, &&invalid};
+    std::size_t pc{};
 
-  void
-  jnz(std::size_t op) {
-    m_pc = m_rega == 0 ? m_pc + 2 : op;
-  }
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (pc >= m_code.size()) {                                                 \
+      return;                                                                  \
+    }                                                                          \
+    goto *handlers[std::to_underlying(m_code[pc].opcode)];                     \
+  } while (false)
 
-  void
-  bxc() {
-    m_regb = m_regb ^ m_regc;
-    m_pc += 2;
-  }
+    DISPATCH();
+  adv:
+    regs[REG_A] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  bxl:
+    regs[REG_B] ^= m_code[pc].operand;
+    pc += 2;
+    DISPATCH();
+  bst:
+    regs[REG_B] = regs[m_code[pc].operand] & 0b111;
+    pc += 2;
+    DISPATCH();
+  jnz:
+    pc = regs[REG_A] == 0 ? pc + 2 : m_code[pc].operand;
+    DISPATCH();
+  bxc:
+    regs[REG_B] ^= regs[REG_C];
+    pc += 2;
+    DISPATCH();
+  out:
+    m_output.push_back(
+        static_cast<std::uint8_t>(regs[m_code[pc].operand] & 0b111));
+    pc += 2;
+    DISPATCH();
+  bdv:
+    regs[REG_B] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  cdv:
+    regs[REG_C] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  invalid:
+    UNREACHABLE(m_program[pc], m_program[pc + 1]);
 
-  void
-  out(std::size_t op) {
-    m_output.emplace_back(combo_op(op) & 0b111);
-    m_pc += 2;
+#undef DISPATCH
+#pragma GCC diagnostic pop
   }
 
+  /// the canonical loop, threaded like `execute_threaded` but over
+  /// `m_loop_body`: the instructions sit next to each other, and the `jnz 0`
+  /// at the end is a handler that starts the next iteration directly, so no
+  /// handler ever checks the program counter against the end of the program
   void
-  bdv(std::size_t op) {
-    m_regb = m_rega / (1LU << combo_op(op));
-    m_pc += 2;
-  }
+  execute_loop(Registers &regs) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static void *const handlers[] = {
+        &&adv, &&bxl, &&bst, &&jnz, &&bxc, &&out, &&bdv, &&cdv, &&invalid};
+    Instruction const *ins = m_loop_body.data();
 
-  void
-  cdv(std::size_t op) {
-    m_regc = m_rega / (1LU << combo_op(op));
-    m_pc += 2;
+#define DISPATCH() goto *handlers[std::to_underlying(ins->opcode)]
+
+    DISPATCH();
+  adv:
+    regs[REG_A] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  bxl:
+    regs[REG_B] ^= ins->operand;
+    ++ins;
+    DISPATCH();
+  bst:
+    regs[REG_B] = regs[ins->operand] & 0b111;
+    ++ins;
+    DISPATCH();
+  jnz:
+    if (regs[REG_A] == 0) {
+      return;
+    }
+    ins = m_loop_body.data();
+    DISPATCH();
+  bxc:
+    regs[REG_B] ^= regs[REG_C];
+    ++ins;
+    DISPATCH();
+  out:
+    m_output.push_back(static_cast<std::uint8_t>(regs[ins->operand] & 0b111));
+    ++ins;
+    DISPATCH();
+  bdv:
+    regs[REG_B] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  cdv:
+    regs[REG_C] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  invalid:
+    UNREACHABLE(std::to_underlying(ins->opcode), ins->operand);
+
+#undef DISPATCH
+#pragma GCC diagnostic pop
   }
 
   std::string
   run() {
-    while (m_pc < m_program.size()) {
-      std::uint64_t ins = m_program[m_pc];
-      std::uint64_t op = m_program[m_pc + 1];
-      switch (ins) {
-      case 0: {
-        adv(op);
-        break;
-      }
-      case 1: {
-        bxl(op);
-        break;
-      }
-      case 2: {
-        bst(op);
-        break;
-      }
-      case 3: {
-        jnz(op);
-        break;
-      }
-      case 4: {
-        bxc();
-        break;
-      }
-      case 5: {
-        out(op);
-        break;
-      }
-      case 6: {
-        bdv(op);
-        break;
-      }
-      case 7: {
-        cdv(op);
-        break;
-      }
-      default: {
-        UNREACHABLE(ins);
-      }
-      }
-    }
-
-    std::stringstream ss;
-    ss << m_output[0];
-    for (std::size_t val : m_output | std::views::drop(1)) {
-      ss << ',' << val;
-    }
-    return ss.str();
+    auto output = execute(
+        m_registers[REG_A], m_registers[REG_B], m_registers[REG_C]);
+    return fmt::format("{}", fmt::join(output, ","));
   }
 };
 
@@ -203,6 +302,29 @@ tests() {
     };
     ASSERT(program_output(lines) == "4,6,3,5,6,3,5,2,1,0");
   }
+  {
+    // the same program; it is not canonical because it drops A's bits with
+    // `adv 1` instead of `adv 3`, so it runs on the general interpreter
+    Computer computer(729, 0, 0, {0, 1, 5, 4, 3, 0});
+    ASSERT(!computer.m_is_canonical_loop);
+    ASSERT(computer.run() == "4,6,3,5,6,3,5,2,1,0");
+  }
+  {
+    Computer computer(2024, 0, 0, {0, 3, 5, 4, 3, 0});
+    ASSERT(computer.m_is_canonical_loop);
+    ASSERT(computer.run() == "5,7,3,0");
+    Computer threaded(2024, 0, 0, {0, 3, 5, 4, 3, 0, 1, 1});
+    ASSERT(!threaded.m_is_canonical_loop);
+    ASSERT(threaded.run() == "5,7,3,0");
+  }
+  {
+    Computer computer(0, 0, 9, {2, 6});
+    computer.run();
+    ASSERT(computer.m_output.empty());
+    // combo operands 0-3 are literals, 4 reads register A
+    Computer literals(12, 0, 0, {5, 0, 5, 1, 5, 2, 5, 3, 5, 4});
+    ASSERT(literals.run() == "0,1,2,3,4");
+  }
 }
 
 std::string
@@ -1,112 +1,359 @@
 #include "utility.hpp"
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <fmt/core.h>
 #include <fstream>
 #include <libassert/assert.hpp>
+#include <limits>
+#include <optional>
 #include <ranges>
 #include <scn/scan.h>
+#include <span>
 #include <string>
 #include <string_view>
 #include <utility>
+#include <vector>
+
+#include "BS_thread_pool.hpp"
+
+enum class Opcode : std::uint8_t
+{
+  adv,
+  bxl,
+  bst,
+  jnz,
+  bxc,
+  out,
+  bdv,
+  cdv,
+  /// an instruction whose combo operand is 7; only an error if it is executed
+  invalid,
+};
+
+/// a pre-decoded instruction; for the instructions that take a combo operand,
+/// `operand` is already the index of its value in the register file
+struct Instruction
+{
+  Opcode opcode;
+  std::uint8_t operand;
+};
+
+/// combo operands 0-3 are literals and 4-6 are the registers A, B and C, so a
+/// register file that starts with the literals resolves every combo operand
+/// with a plain array access
+static constexpr std::size_t REG_A{4};
+static constexpr std::size_t REG_B{5};
+static constexpr std::size_t REG_C{6};
+using Registers = std::array<std::uint64_t, 7>;
+
+/// `val >> shift`, but well-defined for shifts past the width of the type
+constexpr std::uint64_t
+shift_right(std::uint64_t val, std::uint64_t shift) {
+  return shift >= 64 ? 0 : val >> shift;
+}
 
 struct Computer
 {
-  std::uint64_t m_rega{};
-  std::uint64_t m_regb{};
-  std::uint64_t m_regc{};
+  Registers m_registers{0, 1, 2, 3};
   std::vector<std::uint64_t> m_program;
+  /// one decoded instruction per program counter, so that jumps to odd
+  /// addresses still land on a valid instruction
+  std::vector<Instruction> m_code;
+  /// the number of `out`s per iteration if the program is a single
+  /// `... jnz 0` loop that A can be solved for, and 0 otherwise: every
+  /// iteration drops the same number of bits of A, and doesn't read B or C
+  /// before writing them, so nothing but A carries over between iterations
+  std::size_t m_outs_per_loop{};
+  /// the number of bits of A dropped by every iteration of such a loop
+  std::size_t m_bits_per_loop{};
+  /// set if the loop drops A's bits with a single `adv 3` and prints one value
+  /// per iteration; its body is run straight through without checking for
+  /// jumps
+  bool m_is_canonical_loop{};
+  /// the instructions of the canonical loop, one per instruction instead of
+  /// one per program counter, ending with its `jnz 0`
+  std::vector<Instruction> m_loop_body;
+
+  std::vector<std::uint8_t> m_output;
 
   Computer(std::size_t rega,
            std::size_t regb,
            std::size_t regc,
            std::vector<std::uint64_t> program)
-      : m_rega(rega),
-        m_regb(regb),
-        m_regc(regc),
-        m_program(std::move(program)) {}
-
-  std::uint64_t
-  min_rega() {
-    // this was produces by unrolling the assembly of the program, so it doesn't
-    // work for all programs
-    // Program: 2,4,1,5,7,5,1,6,4,3,5,5,0,3,3,0
-    //
-    // bst 4  // regb = rega & 0b111
-    // bxl 5  // regb = regb ^ 0b101
-    // cdv 5  // regc = rega >> regb
-    // bxl 6  // regb = regb ^ 0b110
-    // bxc 3  // regb = regb ^ regc
-    // out 5  // out regb & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // bxl 5  // regb = (rega & 0b111) ^ 0b101
-    // cdv 5  // regc = rega >> regb
-    // bxl 6  // regb = regb ^ 0b110
-    // bxc 3  // regb = regb ^ regc
-    // out 5  // out regb & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // cdv 5  // regc = rega >> ((rega & 0b111) ^ 0b101)
-    // bxl 6  // regb = ((rega & 0b111) ^ 0b101) ^ 0b110
-    // bxc 3  // regb = regb ^ regc
-    // out 5  // out regb & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // bxl 6  // regb = ((rega & 0b111) ^ 0b101) ^ 0b110
-    // bxc 3  // regb = regb ^ (rega >> ((rega & 0b111) ^ 0b101))
-    // out 5  // out regb & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // bxc 3  // regb = (((rega & 0b111) ^ 0b101) ^ 0b110) ^ (rega >> ((rega & 0b111) ^ 0b101))
-    // out 5  // out regb & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // out 5  // out ((((rega & 0b111) ^ 0b101) ^ 0b110) ^ (rega >> ((rega & 0b111) ^ 0b101))) & 0b111
-    // adv 3  // rega = rega / (1 << 3)
-    // jnz 0
-    //
-    // out 5  // out ((((rega & 0b111) ^ 0b101) ^ 0b110) ^ (rega >> ((rega & 0b111) ^ 0b101))) & 0b111
-    // adv 3  // rega = rega >> 3
-    // jnz 0
-
-    std::vector<std::uint64_t> values;
-    values.emplace_back(m_program.back());
-    for (std::uint64_t idx = 0; idx < m_program.size(); ++idx) {
-      std::vector<std::uint64_t> next_values;
-      for (auto value : values) {
-        for (std::uint64_t i = 0b000; i <= 0b111; ++i) {
-          std::uint64_t val = (value << 3UL) + i;
-          auto out = ((((val & 0b111) ^ 0b101) ^ 0b110)
-                      ^ (val >> ((val & 0b111) ^ 0b101)))
-                     & 0b111;
-          if (out == m_program[m_program.size() - idx - 1]) {
-            next_values.emplace_back(val);
-          }
+      : m_program(std::move(program)) {
+    m_registers[REG_A] = rega;
+    m_registers[REG_B] = regb;
+    m_registers[REG_C] = regc;
+    decode();
+    m_output.reserve(m_program.size());
+  }
+
+  void
+  decode() {
+    std::size_t const num_addresses = m_program.empty() ? 0
+                                                        : m_program.size() - 1;
+    m_code.clear();
+    for (std::size_t pc{}; pc < num_addresses; ++pc) {
+      auto opcode = static_cast<Opcode>(m_program[pc]);
+      auto operand = static_cast<std::uint8_t>(m_program[pc + 1]);
+      bool takes_combo = opcode == Opcode::adv || opcode == Opcode::bst
+                         || opcode == Opcode::out || opcode == Opcode::bdv
+                         || opcode == Opcode::cdv;
+      if (m_program[pc] > 7 || (takes_combo && operand > REG_C)) {
+        opcode = Opcode::invalid;
+      }
+      m_code.push_back({opcode, operand});
+    }
+
+    classify_loop();
+
+    m_loop_body.clear();
+    if (m_is_canonical_loop) {
+      for (std::size_t pc{}; pc < m_code.size(); pc += 2) {
+        m_loop_body.push_back(m_code[pc]);
+      }
+    }
+  }
+
+  /// checks whether the program is a loop that A can be solved for, one
+  /// iteration at a time; see `m_outs_per_loop`
+  void
+  classify_loop() {
+    m_outs_per_loop = 0;
+    m_bits_per_loop = 0;
+    m_is_canonical_loop = false;
+    if (m_program.size() % 2 != 0 || m_code.empty()
+        || m_code.back().opcode != Opcode::jnz || m_code.back().operand != 0) {
+      return;
+    }
+
+    std::size_t num_adv{};
+    std::size_t num_out{};
+    bool wrote_b{};
+    bool wrote_c{};
+    for (std::size_t pc{}; pc + 1 < m_code.size(); pc += 2) {
+      Instruction const ins = m_code[pc];
+      bool const reads_b =
+          ins.opcode == Opcode::bxl || ins.opcode == Opcode::bxc
+          || (ins.opcode != Opcode::jnz && ins.operand == REG_B);
+      bool const reads_c = ins.opcode == Opcode::bxc
+                           || (ins.opcode != Opcode::bxl
+                               && ins.opcode != Opcode::jnz
+                               && ins.operand == REG_C);
+      if (ins.opcode == Opcode::jnz || ins.opcode == Opcode::invalid
+          || (reads_b && !wrote_b) || (reads_c && !wrote_c)) {
+        return;
+      }
+      switch (ins.opcode) {
+      case Opcode::adv: {
+        // a shift that depends on the registers doesn't drop a fixed number
+        // of bits
+        if (ins.operand >= REG_A) {
+          return;
         }
+        m_bits_per_loop += ins.operand;
+        ++num_adv;
+        break;
+      }
+      case Opcode::out: {
+        ++num_out;
+        break;
+      }
+      case Opcode::cdv: {
+        wrote_c = true;
+        break;
       }
-      values = std::move(next_values);
+      default: {
+        wrote_b = true;
+        break;
+      }
+      }
+    }
+    if (m_bits_per_loop == 0) {
+      return;
     }
-    return values[0];
+    m_outs_per_loop = num_out;
+    m_is_canonical_loop = num_adv == 1 && m_bits_per_loop == 3 && num_out == 1;
+  }
+
+  /// runs the program from scratch with the given registers; the output
+  /// buffer is reused between runs, so this doesn't allocate once warmed up
+  std::span<std::uint8_t const>
+  execute(std::uint64_t rega, std::uint64_t regb, std::uint64_t regc) {
+    Registers regs = m_registers;
+    regs[REG_A] = rega;
+    regs[REG_B] = regb;
+    regs[REG_C] = regc;
+    m_output.clear();
+
+    if (m_is_canonical_loop) {
+      execute_loop(regs);
+    } else {
+      execute_threaded(regs);
+    }
+    return m_output;
+  }
+
+  /// direct-threaded dispatch: every handler jumps straight to the handler of
+  /// the next instruction, instead of going back through a central switch
+  void
+  execute_threaded(Registers &regs) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static void *const handlers[] = {
+        &&adv, &&bxl, &&bst, &&jnz, &&bxc, &&out, &&bdv, &&cdv, &&invalid};
+    std::size_t pc{};
+
+#define DISPATCH()                                                             \
+  do {                                                                         \
+    if (pc >= m_code.size()) {                                                 \
+      return;                                                                  \
+    }                                                                          \
+    goto *handlers[std::to_underlying(m_code[pc].opcode)];                     \
+  } while (false)
+
+    DISPATCH();
+  adv:
+    regs[REG_A] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  bxl:
+    regs[REG_B] ^= m_code[pc].operand;
+    pc += 2;
+    DISPATCH();
+  bst:
+    regs[REG_B] = regs[m_code[pc].operand] & 0b111;
+    pc += 2;
+    DISPATCH();
+  jnz:
+    pc = regs[REG_A] == 0 ? pc + 2 : m_code[pc].operand;
+    DISPATCH();
+  bxc:
+    regs[REG_B] ^= regs[REG_C];
+    pc += 2;
+    DISPATCH();
+  out:
+    m_output.push_back(
+        static_cast<std::uint8_t>(regs[m_code[pc].operand] & 0b111));
+    pc += 2;
+    DISPATCH();
+  bdv:
+    regs[REG_B] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  cdv:
+    regs[REG_C] = shift_right(regs[REG_A], regs[m_code[pc].operand]);
+    pc += 2;
+    DISPATCH();
+  invalid:
+    UNREACHABLE(m_program[pc], m_program[pc + 1]);
+
+#undef DISPATCH
+#pragma GCC diagnostic pop
+  }
+
+  /// the canonical loop, threaded like `execute_threaded` but over
+  /// `m_loop_body`: the instructions sit next to each other, and the `jnz 0`
+  /// at the end is a handler that starts the next iteration directly, so no
+  /// handler ever checks the program counter against the end of the program
+  void
+  execute_loop(Registers &regs) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+    static void *const handlers[] = {
+        &&adv, &&bxl, &&bst, &&jnz, &&bxc, &&out, &&bdv, &&cdv, &&invalid};
+    Instruction const *ins = m_loop_body.data();
+
+#define DISPATCH() goto *handlers[std::to_underlying(ins->opcode)]
+
+    DISPATCH();
+  adv:
+    regs[REG_A] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  bxl:
+    regs[REG_B] ^= ins->operand;
+    ++ins;
+    DISPATCH();
+  bst:
+    regs[REG_B] = regs[ins->operand] & 0b111;
+    ++ins;
+    DISPATCH();
+  jnz:
+    if (regs[REG_A] == 0) {
+      return;
+    }
+    ins = m_loop_body.data();
+    DISPATCH();
+  bxc:
+    regs[REG_B] ^= regs[REG_C];
+    ++ins;
+    DISPATCH();
+  out:
+    m_output.push_back(static_cast<std::uint8_t>(regs[ins->operand] & 0b111));
+    ++ins;
+    DISPATCH();
+  bdv:
+    regs[REG_B] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  cdv:
+    regs[REG_C] = shift_right(regs[REG_A], regs[ins->operand]);
+    ++ins;
+    DISPATCH();
+  invalid:
+    UNREACHABLE(std::to_underlying(ins->opcode), ins->operand);
+
+#undef DISPATCH
+#pragma GCC diagnostic pop
   }
 };
 
+/// the number of values of A that are run side by side; every per-lane loop
+/// below has no branches that depend on the lane, so the compiler can turn it
+/// into vector instructions
+static constexpr std::size_t NUM_LANES{8};
+using Lanes = std::array<std::uint64_t, NUM_LANES>;
+/// one bit per lane
+using LaneMask = std::uint32_t;
+
 namespace
 {
+void
+tests();
 Computer
 parse_computer(std::ranges::range auto &&lines);
-std::uint64_t
+LaneMask
+match_outputs(Computer &computer,
+              Lanes const &regas,
+              std::span<std::uint64_t const> target,
+              bool exact);
+std::optional<std::uint64_t>
+find_rega_with_prefix(Computer &computer,
+                      std::uint64_t first,
+                      std::uint64_t last,
+                      std::span<std::uint64_t const> prefix);
+std::optional<std::uint64_t>
 min_rega(std::ranges::range auto &&lines);
+std::optional<std::uint64_t>
+min_rega(Computer const &computer);
+void
+search_rega(Computer &computer,
+            std::uint64_t prefix,
+            std::size_t num_digits,
+            std::atomic<std::uint64_t> &best);
+void
+for_each_matching_child(Computer &computer,
+                        std::uint64_t prefix,
+                        std::span<std::uint64_t const> target,
+                        auto const &fn);
 } // namespace
 
 int
 main(int argc, char const *const *argv) {
-  // tests();
+  tests();
 
   auto args = std::span(argv, size_t(argc));
   if (args.size() != 2) {
@@ -125,16 +372,353 @@ main(int argc, char const *const *argv) {
     lines.emplace_back(std::move(line));
   }
 
-  fmt::println("{}", min_rega(lines));
+  auto rega = min_rega(lines);
+  if (!rega) {
+    fmt::println(stderr, "the program can't output a copy of itself");
+    return 3;
+  }
+  fmt::println("{}", *rega);
   return 0;
 }
 
 namespace
 {
-std::uint64_t
+void
+tests() {
+  using namespace std::literals::string_view_literals;
+  {
+    auto const lines = std::array{
+        "Register A: 2024"sv,
+        "Register B: 0"sv,
+        "Register C: 0"sv,
+        ""sv,
+        "Program: 0,3,5,4,3,0"sv,
+    };
+    ASSERT(min_rega(lines) == 117440);
+  }
+  {
+    // not a single `adv 3; jnz 0` loop
+    Computer computer(729, 0, 0, {0, 1, 5, 4, 3, 0});
+    ASSERT(!min_rega(computer).has_value());
+  }
+  {
+    // the loop only ever prints 0s, so it can't print the 3 of `adv 3`
+    Computer computer(0, 0, 0, {0, 3, 5, 0, 3, 0});
+    ASSERT(!min_rega(computer).has_value());
+  }
+  {
+    // `adv 1; adv 3` drops four bits of A per iteration, so the loop isn't
+    // canonical, but A is still solved for one hex digit at a time
+    Computer computer(0, 0, 0, {0, 1, 0, 3, 5, 4, 3, 0});
+    ASSERT(!computer.m_is_canonical_loop);
+    ASSERT(computer.m_bits_per_loop == 4);
+    ASSERT(min_rega(computer) == 877854976);
+    ASSERT(std::ranges::equal(computer.execute(877854976, 0, 0),
+                              computer.m_program));
+  }
+  {
+    // B is read before it is written, so it carries over between iterations
+    // and the digits of A can't be searched independently
+    Computer computer(0, 0, 0, {1, 3, 0, 3, 5, 5, 3, 0});
+    ASSERT(!computer.m_is_canonical_loop);
+    ASSERT(computer.m_outs_per_loop == 0);
+    ASSERT(!min_rega(computer).has_value());
+  }
+  {
+    // two `out`s per iteration leave the canonical loop to the general
+    // interpreter, and A is searched one digit per two values
+    Computer computer(0, 0, 0, {2, 4, 0, 3, 5, 5, 5, 4, 3, 0});
+    ASSERT(!computer.m_is_canonical_loop);
+    ASSERT(computer.m_outs_per_loop == 2);
+    std::optional<std::uint64_t> expected;
+    for (std::uint64_t rega{1}; rega < (1U << (3 * 5)) && !expected; ++rega) {
+      if (std::ranges::equal(computer.execute(rega, 0, 0),
+                             computer.m_program)) {
+        expected = rega;
+      }
+    }
+    ASSERT(min_rega(computer) == expected);
+  }
+  {
+    // the batched runs must agree with one run per value, both for the
+    // canonical loop and for the general interpreter
+    auto const target = std::vector<std::uint64_t>{2, 4, 1};
+    auto const programs = std::array{
+        std::vector<std::uint64_t>{
+            2, 4, 1, 5, 7, 5, 1, 6, 4, 3, 5, 5, 0, 3, 3, 0},
+        std::vector<std::uint64_t>{0, 1, 5, 4, 3, 0},
+        std::vector<std::uint64_t>{2, 4, 0, 3, 5, 5, 5, 4, 3, 0},
+    };
+    for (auto const &program : programs) {
+      Computer computer(0, 0, 0, program);
+      for (std::uint64_t first{}; first < 4096; first += NUM_LANES) {
+        Lanes regas{};
+        std::ranges::iota(regas, first);
+        for (bool exact : {false, true}) {
+          LaneMask mask = match_outputs(computer, regas, target, exact);
+          for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+            auto output = computer.execute(regas[lane], 0, 0);
+            bool matches = exact ? std::ranges::equal(output, target)
+                                 : std::ranges::starts_with(output, target);
+            ASSERT(matches == (((mask >> lane) & 1U) == 1));
+          }
+        }
+      }
+    }
+  }
+  {
+    Computer computer(0, 0, 0, {0, 3, 5, 4, 3, 0});
+    auto const prefix = std::vector<std::uint64_t>{0, 3, 5};
+    // the output is A's octal digits after the lowest one, so the first match
+    // is 0o5300 = 2752
+    ASSERT(find_rega_with_prefix(computer, 0, 10'000, prefix) == 2752);
+    ASSERT(find_rega_with_prefix(computer, 2753, 2754, prefix) == 2753);
+    ASSERT(find_rega_with_prefix(computer, 2760, 2816, prefix)
+           == std::nullopt);
+  }
+}
+
+std::optional<std::uint64_t>
 min_rega(std::ranges::range auto &&lines) {
   Computer computer = parse_computer(lines);
-  return computer.min_rega();
+  return min_rega(computer);
+}
+
+/// for a loop that A can be solved for, every iteration prints the same
+/// number of values and drops the same number of low bits of A, and nothing
+/// but A carries over, so the values printed by the last iteration depend only
+/// on the highest digit of A, one digit being the bits dropped per iteration;
+/// A is therefore rebuilt a digit at a time, from the highest, keeping only the
+/// candidates that print the matching suffix of the program
+///
+/// the subtrees of the highest digit are searched in parallel; all answers
+/// have one digit per iteration, so any partial candidate that can only grow
+/// past the best answer found so far is cut off
+std::optional<std::uint64_t>
+min_rega(Computer const &computer) {
+  static constexpr auto NONE = std::numeric_limits<std::uint64_t>::max();
+
+  std::size_t const outs_per_loop = computer.m_outs_per_loop;
+  if (outs_per_loop == 0 || computer.m_program.empty()
+      || computer.m_program.size() % outs_per_loop != 0
+      || computer.m_program.size() / outs_per_loop
+             > 64 / computer.m_bits_per_loop) {
+    return std::nullopt;
+  }
+
+  Computer first_digits = computer;
+  std::vector<std::uint64_t> digits;
+  for_each_matching_child(first_digits,
+                          0,
+                          std::span(computer.m_program).last(outs_per_loop),
+                          [&digits](std::uint64_t digit) {
+                            digits.push_back(digit);
+                          });
+
+  std::atomic<std::uint64_t> best{NONE};
+  BS::thread_pool pool;
+  for (std::uint64_t digit : digits) {
+    // every worker needs its own computer for the output buffer
+    pool.detach_task([worker = computer, digit, &best]() mutable {
+      search_rega(worker, digit, 1, best);
+    });
+  }
+  pool.wait();
+
+  if (best == NONE) {
+    return std::nullopt;
+  }
+  return best.load();
+}
+
+/// `prefix` holds the highest `num_digits` digits of A, and already prints the
+/// values of the last `num_digits` iterations
+void
+search_rega(Computer &computer,
+            std::uint64_t prefix,
+            std::size_t num_digits,
+            std::atomic<std::uint64_t> &best) {
+  auto const &program = computer.m_program;
+  std::size_t const outs_per_loop = computer.m_outs_per_loop;
+  std::size_t const remaining_digits =
+      (program.size() / outs_per_loop) - num_digits;
+  if ((prefix << (computer.m_bits_per_loop * remaining_digits)) >= best) {
+    return;
+  }
+
+  if (remaining_digits == 0) {
+    std::uint64_t prev_best = best;
+    while (prefix < prev_best
+           && !best.compare_exchange_weak(prev_best, prefix)) {
+    }
+    return;
+  }
+
+  for_each_matching_child(
+      computer,
+      prefix,
+      std::span(program).subspan((remaining_digits - 1) * outs_per_loop),
+      [&computer, num_digits, &best](std::uint64_t child) {
+        search_rega(computer, child, num_digits + 1, best);
+      });
+}
+
+/// calls `fn(child)` for every non-zero A made of `prefix` and one more low
+/// digit whose output is exactly `target`; the digits are checked
+/// `NUM_LANES` at a time, one per lane
+void
+for_each_matching_child(Computer &computer,
+                        std::uint64_t prefix,
+                        std::span<std::uint64_t const> target,
+                        auto const &fn) {
+  std::uint64_t const num_children = 1ULL << computer.m_bits_per_loop;
+  for (std::uint64_t first{}; first < num_children; first += NUM_LANES) {
+    Lanes children{};
+    std::ranges::iota(children, (prefix << computer.m_bits_per_loop) + first);
+    LaneMask mask = match_outputs(computer, children, target, true);
+    for (std::size_t lane{}; lane < NUM_LANES && first + lane < num_children;
+         ++lane) {
+      if (((mask >> lane) & 1U) == 1 && children[lane] != 0) {
+        fn(children[lane]);
+      }
+    }
+  }
+}
+
+/// runs the program once per lane, each lane starting with its own value of A
+/// and the computer's B and C; returns a mask of the lanes whose output starts
+/// with `target` (or, if `exact`, is exactly `target`)
+///
+/// the outputs are compared as they are produced, and a lane is masked off as
+/// soon as its result is known; canonical loops run all the lanes in lockstep,
+/// anything else falls back to one run per lane
+LaneMask
+match_outputs(Computer &computer,
+              Lanes const &regas,
+              std::span<std::uint64_t const> target,
+              bool exact) {
+  LaneMask matches{};
+  if (!computer.m_is_canonical_loop) {
+    for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+      auto output = computer.execute(regas[lane],
+                                     computer.m_registers[REG_B],
+                                     computer.m_registers[REG_C]);
+      bool lane_matches = exact ? std::ranges::equal(output, target)
+                                : std::ranges::starts_with(output, target);
+      matches |= static_cast<LaneMask>(lane_matches) << lane;
+    }
+    return matches;
+  }
+
+  // every register is a vector of lanes, starting with the combo literals
+  std::array<Lanes, std::tuple_size_v<Registers>> regs{};
+  for (std::size_t reg{}; reg < regs.size(); ++reg) {
+    regs[reg].fill(computer.m_registers[reg]);
+  }
+  regs[REG_A] = regas;
+
+  std::array<std::size_t, NUM_LANES> num_matched{};
+  LaneMask active = (1U << NUM_LANES) - 1;
+  std::span<Instruction const> body(computer.m_code.data(),
+                                    computer.m_code.size() - 1);
+  while (active != 0) {
+    for (std::size_t pc{}; pc < body.size(); pc += 2) {
+      Instruction ins = body[pc];
+      // only meaningful for the instructions that take a combo operand
+      Lanes const &combo = regs[std::min<std::size_t>(ins.operand, REG_C)];
+      switch (ins.opcode) {
+      case Opcode::adv: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_A][lane] = shift_right(regs[REG_A][lane], combo[lane]);
+        }
+        break;
+      }
+      case Opcode::bxl: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_B][lane] ^= ins.operand;
+        }
+        break;
+      }
+      case Opcode::bst: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_B][lane] = combo[lane] & 0b111;
+        }
+        break;
+      }
+      case Opcode::bxc: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_B][lane] ^= regs[REG_C][lane];
+        }
+        break;
+      }
+      case Opcode::out: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          if (((active >> lane) & 1U) == 0) {
+            continue;
+          }
+          LaneMask const bit = 1U << lane;
+          if (num_matched[lane] == target.size()) {
+            // the whole target has been printed, and this is one more value
+            active &= ~bit;
+            matches |= exact ? 0 : bit;
+          } else if ((combo[lane] & 0b111) != target[num_matched[lane]]) {
+            active &= ~bit;
+          } else {
+            ++num_matched[lane];
+          }
+        }
+        break;
+      }
+      case Opcode::bdv: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_B][lane] = shift_right(regs[REG_A][lane], combo[lane]);
+        }
+        break;
+      }
+      case Opcode::cdv: {
+        for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+          regs[REG_C][lane] = shift_right(regs[REG_A][lane], combo[lane]);
+        }
+        break;
+      }
+      case Opcode::jnz:
+      case Opcode::invalid: {
+        UNREACHABLE(computer.m_program[pc], computer.m_program[pc + 1]);
+      }
+      }
+    }
+
+    // the `jnz 0` at the end of the loop: the lanes whose A is 0 halt
+    for (std::size_t lane{}; lane < NUM_LANES; ++lane) {
+      LaneMask const bit = 1U << lane;
+      bool const done = num_matched[lane] == target.size();
+      if ((active & bit) != 0 && (regs[REG_A][lane] == 0 || (done && !exact))) {
+        active &= ~bit;
+        matches |= done ? bit : 0;
+      }
+    }
+  }
+  return matches;
+}
+
+/// the first A in `[first, last)` whose output starts with `prefix`, trying
+/// NUM_LANES values at a time
+std::optional<std::uint64_t>
+find_rega_with_prefix(Computer &computer,
+                      std::uint64_t first,
+                      std::uint64_t last,
+                      std::span<std::uint64_t const> prefix) {
+  for (std::uint64_t rega{first}; rega < last; rega += NUM_LANES) {
+    Lanes regas{};
+    std::ranges::iota(regas, rega);
+    LaneMask mask = match_outputs(computer, regas, prefix, false);
+    for (std::size_t lane{}; lane < NUM_LANES && regas[lane] < last; ++lane) {
+      if (((mask >> lane) & 1U) == 1) {
+        return regas[lane];
+      }
+    }
+  }
+  return std::nullopt;
 }
 
 Computer
@@ -1,17 +1,16 @@
 #include <array>
 #include <cstdint>
-#include <deque> // deque
 #include <fmt/core.h>
+#include <fmt/ranges.h> // fmt::join
 #include <fstream>
 #include <libassert/assert.hpp>
+#include <limits> // std::numeric_limits
 #include <ranges>
-#include <scn/scan.h>
 #include <string>
 #include <string_view>
-#include <unordered_map> // unordered_map
 #include <utility>
 
-#include "matrix.hpp"
+#include "BS_thread_pool.hpp"
 #include "utility.hpp"
 
 namespace
@@ -19,17 +18,73 @@ namespace
 void
 tests();
 std::uint64_t
-num_possible_designs(std::ranges::range auto &&lines);
+num_possible_designs(std::ranges::range auto &&lines, bool verbose);
 std::pair<std::vector<std::string>, std::vector<std::string>>
 parse_towels_and_patterns(std::ranges::range auto &&lines);
-std::uint64_t
-num_possible_designs(std::vector<std::string> const &towels,
-                     std::vector<std::string> const &patterns);
-bool
-is_pattern_possible(std::vector<std::string> const &towels,
-                    std::string const &pattern,
-                    std::size_t beg_idx,
-                    std::vector<std::string> &matches);
+
+/// an Aho-Corasick automaton over the towel set; scanning a pattern through it
+/// reports every towel occurrence in a single left-to-right pass
+class TowelAutomaton
+{
+private:
+  static constexpr std::uint32_t ROOT{0};
+  static constexpr std::uint8_t NO_SYMBOL{
+      std::numeric_limits<std::uint8_t>::max()};
+
+  /// maps every byte to a dense symbol, or NO_SYMBOL if no towel contains it
+  std::array<std::uint8_t, 256> m_symbols{};
+  std::size_t m_alphabet_size{};
+  /// the complete transition function, `m_alphabet_size` entries per node
+  std::vector<std::uint32_t> m_goto;
+  /// the length of the towel prefix spelled by each node
+  std::vector<std::uint32_t> m_depth;
+  /// how many towels end exactly at each node
+  std::vector<std::uint32_t> m_num_towels;
+  /// the longest proper suffix of each node that is itself a towel, or ROOT
+  std::vector<std::uint32_t> m_output_link;
+
+  std::uint32_t
+  add_node(std::uint32_t depth);
+
+public:
+  explicit TowelAutomaton(std::vector<std::string> const &towels);
+
+  /// calls `on_match(end, length, multiplicity)` for every towel that matches
+  /// `pattern[end - length, end)`, in increasing order of `end`
+  template <typename F>
+  void
+  for_each_match(std::string_view pattern, F &&on_match) const {
+    std::uint32_t state{ROOT};
+    for (std::size_t end{1}; end <= pattern.size(); ++end) {
+      auto symbol = m_symbols[static_cast<std::uint8_t>(pattern[end - 1])];
+      state = symbol == NO_SYMBOL ? ROOT
+                                  : m_goto[(state * m_alphabet_size) + symbol];
+      std::uint32_t node = m_num_towels[state] != 0 ? state
+                                                    : m_output_link[state];
+      for (; node != ROOT; node = m_output_link[node]) {
+        on_match(end, std::size_t{m_depth[node]}, m_num_towels[node]);
+      }
+    }
+  }
+};
+
+/// the towels that make up a design, in order; `towels` is only filled in when
+/// the arrangement was asked for
+struct Arrangement
+{
+  bool possible;
+  std::vector<std::string_view> towels;
+};
+
+std::vector<Arrangement>
+find_arrangements(TowelAutomaton const &automaton,
+                  std::vector<std::string> const &patterns,
+                  bool keep_towels);
+Arrangement
+find_arrangement(TowelAutomaton const &automaton,
+                 std::string_view pattern,
+                 std::vector<std::uint32_t> &last_towel,
+                 bool keep_towels);
 } // namespace
 
 int
@@ -53,7 +108,7 @@ main(int argc, char const *const *argv) {
     lines.emplace_back(std::move(line));
   }
 
-  fmt::println("{}", num_possible_designs(lines));
+  fmt::println("{}", num_possible_designs(lines, true));
   return 0;
 }
 
@@ -75,14 +130,43 @@ tests() {
         "brgr"sv,
         "bbrgwb"sv,
     };
-    ASSERT(num_possible_designs(lines) == 6);
+    ASSERT(num_possible_designs(lines, false) == 6);
+  }
+  {
+    TowelAutomaton const automaton({"r", "wr", "b", "g", "bwu", "rb", "gb"});
+    auto const patterns = std::vector<std::string>{"gbbr", "ubwu", "bwurrg"};
+    auto arrangements = find_arrangements(automaton, patterns, true);
+    ASSERT(arrangements.size() == 3);
+    ASSERT(arrangements[0].possible);
+    ASSERT(fmt::format("{}", fmt::join(arrangements[0].towels, ","))
+           == "gb,b,r");
+    ASSERT(!arrangements[1].possible);
+    ASSERT(arrangements[1].towels.empty());
+    ASSERT(fmt::format("{}", fmt::join(arrangements[2].towels, ","))
+           == "bwu,r,r,g");
   }
 }
 
+/// the designs are evaluated in parallel first, and only then printed, so that
+/// output never holds up the workers
 std::uint64_t
-num_possible_designs(std::ranges::range auto &&lines) {
+num_possible_designs(std::ranges::range auto &&lines, bool verbose) {
   auto [towels, patterns] = parse_towels_and_patterns(lines);
-  return num_possible_designs(towels, patterns);
+  TowelAutomaton const automaton(towels);
+  auto arrangements = find_arrangements(automaton, patterns, verbose);
+
+  if (verbose) {
+    for (auto const &[pattern, arrangement] :
+         std::views::zip(patterns, arrangements)) {
+      if (arrangement.possible) {
+        fmt::println("{}: {}", pattern, fmt::join(arrangement.towels, ","));
+      } else {
+        fmt::println("{}: impossible", pattern);
+      }
+    }
+  }
+  return static_cast<std::uint64_t>(std::ranges::count_if(
+      arrangements, [](Arrangement const &arr) { return arr.possible; }));
 }
 
 std::pair<std::vector<std::string>, std::vector<std::string>>
@@ -104,51 +188,128 @@ parse_towels_and_patterns(std::ranges::range auto &&lines) {
   return {towels, patterns};
 }
 
-std::uint64_t
-num_possible_designs(std::vector<std::string> const &towels,
-                     std::vector<std::string> const &patterns) {
-  std::uint64_t num_possible{};
-  for (auto const &pattern : patterns) {
-    std::vector<std::string> matches;
-    fmt::print("{}: ", pattern);
-    if (is_pattern_possible(towels, pattern, 0, matches)) {
-      bool is_first = true;
-      for (std::string const &match : matches | std::views::reverse) {
-        if (is_first) {
-          is_first = false;
-          fmt::print("{}", match);
-        } else {
-          fmt::print(",{}", match);
-        }
+/// evaluates all the patterns against the same immutable automaton, with the
+/// patterns sharded across the thread pool; every shard reuses a single DP
+/// buffer for all of its patterns
+std::vector<Arrangement>
+find_arrangements(TowelAutomaton const &automaton,
+                  std::vector<std::string> const &patterns,
+                  bool keep_towels) {
+  std::vector<Arrangement> arrangements(patterns.size());
+
+  BS::thread_pool pool;
+  std::size_t const num_shards =
+      std::min<std::size_t>(pool.get_thread_count(), patterns.size());
+  for (std::size_t shard{}; shard < num_shards; ++shard) {
+    pool.detach_task([&automaton,
+                      &patterns,
+                      &arrangements,
+                      shard,
+                      num_shards,
+                      keep_towels] {
+      std::vector<std::uint32_t> last_towel;
+      for (std::size_t idx{shard}; idx < patterns.size(); idx += num_shards) {
+        arrangements[idx] = find_arrangement(
+            automaton, patterns[idx], last_towel, keep_towels);
       }
-      fmt::println("");
-      ++num_possible;
-    } else {
-      fmt::println("impossible");
-    }
+    });
   }
+  pool.wait();
+  return arrangements;
+}
+
+/// forward reachability over the pattern prefixes; `last_towel[end]` holds the
+/// length of the first towel found to end a buildable prefix at `end` (0 if
+/// there is none), which is enough to walk one arrangement back from the end
+Arrangement
+find_arrangement(TowelAutomaton const &automaton,
+                 std::string_view pattern,
+                 std::vector<std::uint32_t> &last_towel,
+                 bool keep_towels) {
+  static constexpr auto START = std::numeric_limits<std::uint32_t>::max();
+
+  last_towel.assign(pattern.size() + 1, 0);
+  last_towel[0] = START;
+  automaton.for_each_match(
+      pattern,
+      [&last_towel](std::size_t end, std::size_t length, std::uint64_t) {
+        if (last_towel[end] == 0 && last_towel[end - length] != 0) {
+          last_towel[end] = static_cast<std::uint32_t>(length);
+        }
+      });
 
-  return num_possible;
+  Arrangement arrangement{last_towel.back() != 0, {}};
+  if (arrangement.possible && keep_towels) {
+    for (std::size_t end{pattern.size()}; end != 0; end -= last_towel[end]) {
+      arrangement.towels.push_back(
+          pattern.substr(end - last_towel[end], last_towel[end]));
+    }
+    std::ranges::reverse(arrangement.towels);
+  }
+  return arrangement;
 }
 
-bool
-is_pattern_possible(std::vector<std::string> const &towels,
-                    std::string const &pattern,
-                    std::size_t beg_idx,
-                    std::vector<std::string> &matches) {
-  if (beg_idx == pattern.size()) {
-    return true;
+TowelAutomaton::TowelAutomaton(std::vector<std::string> const &towels) {
+  m_symbols.fill(NO_SYMBOL);
+  for (std::string const &towel : towels) {
+    for (char ch : towel) {
+      auto &symbol = m_symbols[static_cast<std::uint8_t>(ch)];
+      if (symbol == NO_SYMBOL) {
+        symbol = static_cast<std::uint8_t>(m_alphabet_size++);
+      }
+    }
   }
+
+  // build the trie, using 0 as "no edge" since nothing points back to ROOT yet
+  add_node(0);
   for (std::string const &towel : towels) {
-    if (pattern.substr(beg_idx, towel.size()) != towel) {
-      continue;
+    std::uint32_t node{ROOT};
+    for (char ch : towel) {
+      auto symbol = m_symbols[static_cast<std::uint8_t>(ch)];
+      if (m_goto[(node * m_alphabet_size) + symbol] == ROOT) {
+        std::uint32_t child = add_node(m_depth[node] + 1);
+        m_goto[(node * m_alphabet_size) + symbol] = child;
+      }
+      node = m_goto[(node * m_alphabet_size) + symbol];
     }
-    if (is_pattern_possible(towels, pattern, beg_idx + towel.size(), matches)) {
-      matches.emplace_back(towel);
-      return true;
+    ++m_num_towels[node];
+  }
+
+  // breadth-first, turn the trie into a complete automaton: missing edges
+  // follow the failure link, and output links skip non-towel suffixes
+  std::vector<std::uint32_t> fail(m_depth.size(), ROOT);
+  std::vector<std::uint32_t> queue;
+  queue.reserve(m_depth.size());
+  for (std::size_t symbol{}; symbol < m_alphabet_size; ++symbol) {
+    if (m_goto[symbol] != ROOT) {
+      queue.push_back(m_goto[symbol]);
     }
   }
+  for (std::size_t head{}; head < queue.size(); ++head) {
+    std::uint32_t node = queue[head];
+    for (std::size_t symbol{}; symbol < m_alphabet_size; ++symbol) {
+      std::uint32_t &child = m_goto[(node * m_alphabet_size) + symbol];
+      std::uint32_t fallback =
+          m_goto[(fail[node] * m_alphabet_size) + symbol];
+      if (child == ROOT) {
+        child = fallback;
+        continue;
+      }
+      fail[child] = fallback;
+      m_output_link[child] =
+          m_num_towels[fallback] != 0 ? fallback : m_output_link[fallback];
+      queue.push_back(child);
+    }
+  }
+}
 
-  return false;
+std::uint32_t
+TowelAutomaton::add_node(std::uint32_t depth) {
+  auto node = static_cast<std::uint32_t>(m_depth.size());
+  m_goto.resize(m_goto.size() + m_alphabet_size, ROOT);
+  m_depth.push_back(depth);
+  m_num_towels.push_back(0);
+  m_output_link.push_back(ROOT);
+  return node;
 }
 } // namespace
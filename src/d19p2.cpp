@@ -5,11 +5,12 @@
 #include <fstream> // std::ifstream
 #include <libassert/assert.hpp> // ASSERT
 #include <ranges> // std::span
+#include <limits> // std::numeric_limits
 #include <string> // std::string
-#include <unordered_map> // std::unordered_map
+#include <string_view> // std::string_view
 #include <vector> // std::vector
 
-#include "matrix.hpp" // Matrix
+#include "BS_thread_pool.hpp"
 #include "utility.hpp" // split
 
 namespace
@@ -20,16 +21,64 @@ std::uint64_t
 num_possible_ways(std::ranges::range auto &&lines);
 std::pair<std::vector<std::string>, std::vector<std::string>>
 parse_towels_and_patterns(std::ranges::range auto &&lines);
-std::uint64_t
-find_all_ways(std::vector<std::string> const &towels,
-              std::string const &pattern);
-Matrix<std::uint64_t>
-build_adj_matrix(std::vector<std::string> const &towels,
-                 std::string const &pattern);
-std::uint64_t
-num_ways_from_to_end(std::uint64_t from,
-                     Matrix<std::uint64_t> const &adj_matrix,
-                     std::unordered_map<std::uint64_t, std::uint64_t> &map);
+
+/// an Aho-Corasick automaton over the towel set; scanning a pattern through it
+/// reports every towel occurrence in a single left-to-right pass
+class TowelAutomaton
+{
+private:
+  static constexpr std::uint32_t ROOT{0};
+  static constexpr std::uint8_t NO_SYMBOL{
+      std::numeric_limits<std::uint8_t>::max()};
+
+  /// maps every byte to a dense symbol, or NO_SYMBOL if no towel contains it
+  std::array<std::uint8_t, 256> m_symbols{};
+  std::size_t m_alphabet_size{};
+  /// the complete transition function, `m_alphabet_size` entries per node
+  std::vector<std::uint32_t> m_goto;
+  /// the length of the towel prefix spelled by each node
+  std::vector<std::uint32_t> m_depth;
+  /// how many towels end exactly at each node
+  std::vector<std::uint32_t> m_num_towels;
+  /// the longest proper suffix of each node that is itself a towel, or ROOT
+  std::vector<std::uint32_t> m_output_link;
+
+  std::uint32_t
+  add_node(std::uint32_t depth);
+
+public:
+  explicit TowelAutomaton(std::vector<std::string> const &towels);
+
+  /// calls `on_match(end, length, multiplicity)` for every towel that matches
+  /// `pattern[end - length, end)`, in increasing order of `end`
+  template <typename F>
+  void
+  for_each_match(std::string_view pattern, F &&on_match) const {
+    std::uint32_t state{ROOT};
+    for (std::size_t end{1}; end <= pattern.size(); ++end) {
+      auto symbol = m_symbols[static_cast<std::uint8_t>(pattern[end - 1])];
+      state = symbol == NO_SYMBOL ? ROOT
+                                  : m_goto[(state * m_alphabet_size) + symbol];
+      std::uint32_t node = m_num_towels[state] != 0 ? state
+                                                    : m_output_link[state];
+      for (; node != ROOT; node = m_output_link[node]) {
+        on_match(end, std::size_t{m_depth[node]}, m_num_towels[node]);
+      }
+    }
+  }
+};
+
+std::vector<std::uint64_t>
+find_all_ways(TowelAutomaton const &automaton,
+              std::vector<std::string> const &patterns);
+template <typename Count>
+Count
+find_all_ways(TowelAutomaton const &automaton,
+              std::string_view pattern,
+              std::vector<Count> &ways);
+template <typename Count = std::uint64_t>
+Count
+find_all_ways(TowelAutomaton const &automaton, std::string_view pattern);
 } // namespace
 
 int
@@ -77,17 +126,57 @@ tests() {
     };
     ASSERT(num_possible_ways(lines) == 16);
   }
+  {
+    TowelAutomaton const automaton({"r", "wr", "b", "g", "bwu", "rb", "gb"});
+    ASSERT(find_all_ways(automaton, "") == 1);
+    ASSERT(find_all_ways(automaton, "gbbr") == 2);
+    ASSERT(find_all_ways(automaton, "ubwu") == 0);
+    ASSERT(find_all_ways(automaton, "bwurrgx") == 0);
+
+    auto const patterns = std::vector<std::string>{
+        "gbbr", "ubwu", "", "rrbgb", "bwurrg", "gbbr"};
+    auto const expected = std::vector<std::uint64_t>{2, 0, 1, 4, 1, 2};
+    ASSERT(find_all_ways(automaton, patterns) == expected);
+  }
+  {
+    // duplicated towels are distinct ways of making the same stripes
+    TowelAutomaton const automaton({"r", "r", "rr", "b"});
+    ASSERT(find_all_ways(automaton, "rrb") == 5);
+  }
+  {
+    // the number of ways of building r^n out of {r, rr} is fib(n + 1), which
+    // overflows 64 bits at n = 93 and 128 bits at n = 185
+    TowelAutomaton const automaton({"r", "rr"});
+    uint128_t fib_prev{1};
+    uint128_t fib{1};
+    for (std::size_t len{2}; len <= 150; ++len) {
+      fib_prev = std::exchange(fib, fib + fib_prev);
+    }
+    std::string const pattern(150, 'r');
+    ASSERT(find_all_ways<uint128_t>(automaton, pattern) == fib);
+    ASSERT(find_all_ways(automaton, pattern) == ~std::uint64_t{});
+
+    std::string const long_pattern(1'000'000, 'r');
+    ASSERT(find_all_ways<uint128_t>(automaton, long_pattern) == ~uint128_t{});
+  }
+  {
+    TowelAutomaton const automaton({"bwu", "bw", "u"});
+    std::string long_pattern;
+    for (std::size_t idx{}; idx < 333'333; ++idx) {
+      long_pattern += "bwu";
+    }
+    ASSERT(find_all_ways(automaton, long_pattern) == ~std::uint64_t{});
+    long_pattern += 'b';
+    ASSERT(find_all_ways(automaton, long_pattern) == 0);
+  }
 }
 
 std::uint64_t
 num_possible_ways(std::ranges::range auto &&lines) {
   auto [towels, patterns] = parse_towels_and_patterns(lines);
+  TowelAutomaton const automaton(towels);
   return std::ranges::fold_left(
-      patterns,
-      0ULL,
-      [&towels](std::uint64_t const &prev, std::string const &pattern) {
-        return prev + find_all_ways(towels, pattern);
-      });
+      find_all_ways(automaton, patterns), 0ULL, std::plus<>());
 }
 
 std::pair<std::vector<std::string>, std::vector<std::string>>
@@ -109,45 +198,123 @@ parse_towels_and_patterns(std::ranges::range auto &&lines) {
   return {towels, patterns};
 }
 
-std::uint64_t
-find_all_ways(std::vector<std::string> const &towels,
-              std::string const &pattern) {
-  auto const adj_matrix = build_adj_matrix(towels, pattern);
+/// evaluates all the patterns against the same immutable automaton, with the
+/// patterns sharded across the thread pool; every shard reuses a single DP
+/// buffer for all of its patterns
+std::vector<std::uint64_t>
+find_all_ways(TowelAutomaton const &automaton,
+              std::vector<std::string> const &patterns) {
+  std::vector<std::uint64_t> all_ways(patterns.size());
 
-  std::unordered_map<std::uint64_t, std::uint64_t> map;
-  map[pattern.size()] = 1; // terminating condition
-  return num_ways_from_to_end(0, adj_matrix, map);
+  BS::thread_pool pool;
+  std::size_t const num_shards =
+      std::min<std::size_t>(pool.get_thread_count(), patterns.size());
+  for (std::size_t shard{}; shard < num_shards; ++shard) {
+    // strided shards keep long and short patterns spread over all workers
+    pool.detach_task([&automaton, &patterns, &all_ways, shard, num_shards] {
+      std::vector<std::uint64_t> ways;
+      for (std::size_t idx{shard}; idx < patterns.size(); idx += num_shards) {
+        all_ways[idx] = find_all_ways(automaton, patterns[idx], ways);
+      }
+    });
+  }
+  pool.wait();
+  return all_ways;
+}
+
+template <typename Count>
+Count
+find_all_ways(TowelAutomaton const &automaton, std::string_view pattern) {
+  std::vector<Count> ways;
+  return find_all_ways(automaton, pattern, ways);
 }
 
-Matrix<std::uint64_t>
-build_adj_matrix(std::vector<std::string> const &towels,
-                 std::string const &pattern) {
-  Matrix<std::uint64_t> adj_matrix(pattern.size(), pattern.size() + 1, 0);
-  for (std::size_t idx = 0; idx < pattern.size(); ++idx) {
-    for (std::string const &towel : towels) {
-      if (pattern.substr(idx, towel.size()) == towel) {
-        ++adj_matrix(idx, idx + towel.size());
+/// forward DP over the pattern prefixes: every towel match
+/// `[end - length, end)` extends all the ways of building the first
+/// `end - length` stripes; the automaton reports matches in increasing order of
+/// `end`, so `ways[end - length]` is final by the time it is read
+///
+/// the pass is iterative and costs O(len * max_towel_len) at worst, so designs
+/// of millions of stripes are fine; counts saturate at the largest `Count`
+/// instead of wrapping, and `uint128_t` can be used when 64 bits are too few
+template <typename Count>
+Count
+find_all_ways(TowelAutomaton const &automaton,
+              std::string_view pattern,
+              std::vector<Count> &ways) {
+  ways.assign(pattern.size() + 1, 0);
+  ways[0] = 1;
+  automaton.for_each_match(
+      pattern,
+      [&ways](std::size_t end, std::size_t length, std::uint64_t multiplicity) {
+        auto count = static_cast<Count>(multiplicity);
+        ways[end] = saturating_add(ways[end],
+                                   saturating_mul(ways[end - length], count));
+      });
+  return ways.back();
+}
+
+TowelAutomaton::TowelAutomaton(std::vector<std::string> const &towels) {
+  m_symbols.fill(NO_SYMBOL);
+  for (std::string const &towel : towels) {
+    for (char ch : towel) {
+      auto &symbol = m_symbols[static_cast<std::uint8_t>(ch)];
+      if (symbol == NO_SYMBOL) {
+        symbol = static_cast<std::uint8_t>(m_alphabet_size++);
       }
     }
   }
-  return adj_matrix;
-}
 
-std::uint64_t
-num_ways_from_to_end(std::uint64_t from,
-                     Matrix<std::uint64_t> const &adj_matrix,
-                     std::unordered_map<std::uint64_t, std::uint64_t> &map) {
-  auto find_it = map.find(from);
-  if (find_it != map.end()) {
-    return find_it->second;
+  // build the trie, using 0 as "no edge" since nothing points back to ROOT yet
+  add_node(0);
+  for (std::string const &towel : towels) {
+    std::uint32_t node{ROOT};
+    for (char ch : towel) {
+      auto symbol = m_symbols[static_cast<std::uint8_t>(ch)];
+      if (m_goto[(node * m_alphabet_size) + symbol] == ROOT) {
+        std::uint32_t child = add_node(m_depth[node] + 1);
+        m_goto[(node * m_alphabet_size) + symbol] = child;
+      }
+      node = m_goto[(node * m_alphabet_size) + symbol];
+    }
+    ++m_num_towels[node];
   }
 
-  std::uint64_t num_ways{};
-  for (std::size_t to{from + 1}; to < adj_matrix.cols(); ++to) {
-    if (adj_matrix(from, to) == 1) {
-      num_ways += num_ways_from_to_end(to, adj_matrix, map);
+  // breadth-first, turn the trie into a complete automaton: missing edges
+  // follow the failure link, and output links skip non-towel suffixes
+  std::vector<std::uint32_t> fail(m_depth.size(), ROOT);
+  std::vector<std::uint32_t> queue;
+  queue.reserve(m_depth.size());
+  for (std::size_t symbol{}; symbol < m_alphabet_size; ++symbol) {
+    if (m_goto[symbol] != ROOT) {
+      queue.push_back(m_goto[symbol]);
     }
   }
-  return map.emplace(from, num_ways).first->second;
+  for (std::size_t head{}; head < queue.size(); ++head) {
+    std::uint32_t node = queue[head];
+    for (std::size_t symbol{}; symbol < m_alphabet_size; ++symbol) {
+      std::uint32_t &child = m_goto[(node * m_alphabet_size) + symbol];
+      std::uint32_t fallback =
+          m_goto[(fail[node] * m_alphabet_size) + symbol];
+      if (child == ROOT) {
+        child = fallback;
+        continue;
+      }
+      fail[child] = fallback;
+      m_output_link[child] =
+          m_num_towels[fallback] != 0 ? fallback : m_output_link[fallback];
+      queue.push_back(child);
+    }
+  }
+}
+
+std::uint32_t
+TowelAutomaton::add_node(std::uint32_t depth) {
+  auto node = static_cast<std::uint32_t>(m_depth.size());
+  m_goto.resize(m_goto.size() + m_alphabet_size, ROOT);
+  m_depth.push_back(depth);
+  m_num_towels.push_back(0);
+  m_output_link.push_back(ROOT);
+  return node;
 }
 } // namespace
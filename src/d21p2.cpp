@@ -4,43 +4,17 @@
 #include <fmt/ranges.h> // fmt::print
 #include <fstream> // std::ifstream
 #include <libassert/assert.hpp> // ASSERT
-#include <queue> // std::priority_queue
 #include <ranges> // std::views::enumerate
 #include <string> // std::string
-#include <unordered_map> // std::unordered_map
+#include <string_view> // std::string_view
 #include <vector> // std::vector
 
-#include "matrix.hpp" // Matrix
-#include "utility.hpp" // split
+#include "utility.hpp" // str_to_int
 
 using u64 = std::uint64_t;
-struct cache_key
-{
-  char src;
-  char dst;
-  u64 depth;
-};
-
-bool
-operator==(cache_key const &lhs, cache_key const &rhs) {
-  return lhs.src == rhs.src && lhs.dst == rhs.dst && lhs.depth == rhs.depth;
-}
-
-template <>
-struct std::hash<cache_key>
-{
-  std::size_t
-  operator()(cache_key const &key) const noexcept {
-    std::size_t h1 = std::hash<std::size_t>{}(key.src);
-    std::size_t h2 = std::hash<std::size_t>{}(key.dst);
-    std::size_t h3 = std::hash<std::size_t>{}(key.depth);
-
-    std::size_t ret_val = 0;
-    hash_combine(ret_val, h1, h2, h3);
-    return ret_val;
-  }
-};
-
+/// costs grow exponentially with the number of robots, so they are kept in
+/// 128 bits and saturate instead of wrapping once even that is not enough
+using Cost = uint128_t;
 using namespace std::literals::string_view_literals;
 
 auto constexpr keypad1_lines = std::array{
@@ -59,31 +33,154 @@ auto constexpr keypad2_lines = std::array{
     "#####"sv,
 };
 
+/// the keys of each keypad, in the order used to index the tables below
+auto constexpr keypad1_keys = "0123456789A"sv;
+auto constexpr keypad2_keys = "^A<v>"sv;
+
+/// the number of directional keypads between the human and the numeric keypad
+static constexpr u64 NUM_ROBOTS{25};
+
+/// a shortest way of moving between two keys: `count1` presses of `dir1`
+/// followed by `count2` presses of `dir2`
+struct Moves
+{
+  char dir1;
+  u64 count1;
+  char dir2;
+  u64 count2;
+};
+
+/// the shortest move sequences worth trying between two keys; a path that
+/// turns more than once never beats one that turns at most once, so only
+/// "horizontal first" and "vertical first" remain, minus any that would cross
+/// the gap in the keypad
+struct Candidates
+{
+  std::array<Moves, 2> moves;
+  std::size_t size;
+};
+
+template <std::size_t N>
+using MoveTable = std::array<std::array<Candidates, N>, N>;
+
+template <std::size_t N>
+using CostMatrix = std::array<std::array<Cost, N>, N>;
+
+/// `costs[src][dst]` is the number of presses the human needs to move the arm
+/// of a robot from `src` to `dst` on the directional keypad and press `dst`
+using DirectionCosts = CostMatrix<keypad2_keys.size()>;
+
 namespace
 {
 void
 tests();
-u64
-get_sum_complexities(std::ranges::range auto &&lines);
-u64
-get_num_moves(std::string_view line,
-              Matrix<char> const &keypad1,
-              Matrix<char> const &keypad2);
-Matrix<char>
-parse_keypad(std::ranges::range auto &&lines);
-std::vector<std::vector<char>>
-all_shortest_paths(char src,
-                   char dst,
-                   Matrix<char> const &keypad1,
-                   Matrix<char> const &keypad2,
-                   u64 depth);
-u64
-get_path_with_min_cost(char src,
-                       char dst,
-                       Matrix<char> const &keypad1,
-                       Matrix<char> const &keypad2,
-                       u64 depth,
-                       std::unordered_map<cache_key, u64> &cache);
+/// the costs of typing on the numeric keypad through a chain of robots; the
+/// table is built once and shared by all the codes typed into the chain
+class RobotChain
+{
+private:
+  CostMatrix<keypad1_keys.size()> m_keypad1_costs;
+
+public:
+  explicit RobotChain(u64 num_robots);
+
+  [[nodiscard]] Cost
+  get_cost(char src, char dst) const;
+  [[nodiscard]] Cost
+  get_num_moves(std::string_view line) const;
+};
+
+Cost
+get_sum_complexities(std::ranges::range auto &&lines, u64 num_robots);
+
+constexpr std::size_t
+key_index(char key, std::string_view keys) {
+  ASSERT(keys.find(key) != std::string_view::npos, "key not found", key);
+  return keys.find(key);
+}
+
+template <std::size_t R>
+constexpr Location
+find_key(char key, std::array<std::string_view, R> const &keypad) {
+  for (std::size_t row{}; row < keypad.size(); ++row) {
+    std::size_t col = keypad[row].find(key);
+    if (col != std::string_view::npos) {
+      return {row, col};
+    }
+  }
+  UNREACHABLE("key not found", key);
+}
+
+template <std::size_t N, std::size_t R>
+constexpr MoveTable<N>
+build_move_table(std::string_view keys,
+                 std::array<std::string_view, R> const &keypad) {
+  MoveTable<N> table{};
+  for (std::size_t src{}; src < N; ++src) {
+    for (std::size_t dst{}; dst < N; ++dst) {
+      auto [src_row, src_col] = find_key(keys[src], keypad);
+      auto [dst_row, dst_col] = find_key(keys[dst], keypad);
+      char vdir = dst_row < src_row ? '^' : 'v';
+      char hdir = dst_col < src_col ? '<' : '>';
+      u64 vcount = dst_row < src_row ? src_row - dst_row : dst_row - src_row;
+      u64 hcount = dst_col < src_col ? src_col - dst_col : dst_col - src_col;
+
+      Candidates &candidates = table[src][dst];
+      if (keypad[src_row][dst_col] != '#') {
+        candidates.moves[candidates.size++] = {hdir, hcount, vdir, vcount};
+      }
+      if (keypad[dst_row][src_col] != '#' && hcount != 0 && vcount != 0) {
+        candidates.moves[candidates.size++] = {vdir, vcount, hdir, hcount};
+      }
+    }
+  }
+  return table;
+}
+
+constexpr auto keypad1_moves =
+    build_move_table<keypad1_keys.size()>(keypad1_keys, keypad1_lines);
+constexpr auto keypad2_moves =
+    build_move_table<keypad2_keys.size()>(keypad2_keys, keypad2_lines);
+
+/// the cost of typing "<moves>A" on a directional keypad whose arm starts on
+/// 'A'
+constexpr Cost
+get_moves_cost(Moves const &moves, DirectionCosts const &costs) {
+  Cost cost{};
+  std::size_t prev = key_index('A', keypad2_keys);
+  for (auto [dir, count] : {std::pair{moves.dir1, moves.count1},
+                            std::pair{moves.dir2, moves.count2}}) {
+    if (count == 0) {
+      continue;
+    }
+    std::size_t curr = key_index(dir, keypad2_keys);
+    cost = saturating_add(cost, costs[prev][curr]);
+    cost = saturating_add(cost,
+                          saturating_mul(Cost{count - 1}, costs[curr][curr]));
+    prev = curr;
+  }
+  return saturating_add(cost, costs[prev][key_index('A', keypad2_keys)]);
+}
+
+/// one robot layer: the min-plus step from the costs of the keypad above to
+/// the costs of the keypad below, over the precomputed candidate moves
+template <std::size_t N>
+constexpr CostMatrix<N>
+get_layer_costs(MoveTable<N> const &table, DirectionCosts const &costs) {
+  CostMatrix<N> layer_costs{};
+  for (std::size_t src{}; src < N; ++src) {
+    for (std::size_t dst{}; dst < N; ++dst) {
+      Candidates const &candidates = table[src][dst];
+      Cost min_cost = ~Cost{};
+      for (std::size_t idx{}; idx < candidates.size; ++idx) {
+        min_cost = std::min(min_cost,
+                            get_moves_cost(candidates.moves[idx], costs));
+      }
+      layer_costs[src][dst] = min_cost;
+    }
+  }
+  return layer_costs;
+}
 } // namespace
 
 int
@@ -107,7 +204,7 @@ main(int argc, char const *const *argv) {
     lines.emplace_back(std::move(line));
   }
 
-  fmt::println("{}", get_sum_complexities(lines));
+  fmt::println("{}", get_sum_complexities(lines, NUM_ROBOTS));
   return 0;
 }
 
@@ -115,160 +212,96 @@ namespace
 {
 void
 tests() {
-  // no tests
+  {
+    std::size_t src = key_index('A', keypad1_keys);
+    std::size_t dst = key_index('1', keypad1_keys);
+    auto const &candidates = keypad1_moves[src][dst];
+    // going left first would cross the gap
+    ASSERT(candidates.size == 1);
+    ASSERT(candidates.moves[0].dir1 == '^');
+  }
+  {
+    // with two robots, the costs must match the ones of the first part
+    RobotChain const chain(2);
+    ASSERT(chain.get_cost('A', '3') == 12);
+    ASSERT(chain.get_cost('3', '7') == 23);
+    ASSERT(chain.get_cost('7', '9') == 11);
+    ASSERT(chain.get_cost('9', 'A') == 18);
+    ASSERT(chain.get_cost('4', '0') == 22);
+  }
+  {
+    // without robots, the human types the shortest paths directly
+    ASSERT(RobotChain(0).get_num_moves("029A") == 12);
+    ASSERT(RobotChain(0).get_cost('3', '3') == 1);
+  }
+  {
+    auto const lines = std::array{
+        "029A"sv,
+        "980A"sv,
+        "179A"sv,
+        "456A"sv,
+        "379A"sv,
+    };
+    ASSERT(get_sum_complexities(lines, 2) == 126384);
+    ASSERT(get_sum_complexities(lines, NUM_ROBOTS) == 154115708116294);
+
+    // deep chains saturate, but pressing the same key again is a single press
+    RobotChain const deep_chain(5'000'000);
+    ASSERT(deep_chain.get_num_moves("029A") == ~Cost{});
+    ASSERT(deep_chain.get_cost('7', '7') == 1);
+    ASSERT(get_sum_complexities(lines, 5'000'000) == ~Cost{});
+  }
 }
 
-u64
-get_sum_complexities(std::ranges::range auto &&lines) {
-  auto const keypad1 = parse_keypad(keypad1_lines);
-  auto const keypad2 = parse_keypad(keypad2_lines);
+Cost
+get_sum_complexities(std::ranges::range auto &&lines, u64 num_robots) {
+  RobotChain const chain(num_robots);
 
   return std::ranges::fold_left(
-      lines,
-      0ULL,
-      [&keypad1, &keypad2](u64 prev, std::string_view line) {
-        return prev
-               + str_to_int<u64>(line.substr(0, line.size() - 1))
-                     * get_num_moves(line, keypad1, keypad2);
+      lines, Cost{}, [&chain](Cost prev, std::string_view line) {
+        Cost code{str_to_int<u64>(line.substr(0, line.size() - 1))};
+        return saturating_add(prev,
+                              saturating_mul(code, chain.get_num_moves(line)));
       });
 }
 
-u64
-get_num_moves(std::string_view line,
-              Matrix<char> const &keypad1,
-              Matrix<char> const &keypad2) {
-  std::unordered_map<cache_key, u64> cache;
-
-  return get_path_with_min_cost('A', line[0], keypad1, keypad2, 25, cache)
-         + std::ranges::fold_left(
-             line | std::views::slide(2),
-             0ULL,
-             [&keypad1, &keypad2, &cache](u64 prev, auto const &window) {
-               return prev
-                      + get_path_with_min_cost(window[0],
-                                               window[1],
-                                               keypad1,
-                                               keypad2,
-                                               25,
-                                               cache);
-             });
-}
-
-Location
-find_key(char key, Matrix<char> const &keypad) {
-  for (std::size_t row{}; row < keypad.rows(); ++row) {
-    for (std::size_t col{}; col < keypad.cols(); ++col) {
-      if (keypad(row, col) == key) {
-        return {row, col};
-      }
-    }
+/// the human presses every key directly, so every move costs a single press;
+/// each robot then adds one layer on top, and the last layer is typed on the
+/// numeric keypad
+///
+/// the layer step takes the minimum over sums of several costs, so it is not a
+/// single min-plus matrix product that could be squared; instead, once all
+/// the costs have saturated, further layers no longer change anything, which
+/// bounds the work for chains of any depth to a few hundred layers
+RobotChain::RobotChain(u64 num_robots) {
+  DirectionCosts costs{};
+  for (auto &row : costs) {
+    row.fill(1);
   }
-  UNREACHABLE("key not found", key);
-}
-
-Matrix<char>
-parse_keypad(std::ranges::range auto &&lines) {
-  Matrix<char> grid(lines.size(), lines[0].size(), ' ');
-  for (auto const [row, line] : std::views::enumerate(lines)) {
-    for (auto const [col, ch] : std::views::enumerate(line)) {
-      grid(row, col) = ch;
+  for (u64 robot{}; robot < num_robots; ++robot) {
+    auto next_costs = get_layer_costs(keypad2_moves, costs);
+    if (next_costs == costs) {
+      break;
     }
+    costs = next_costs;
   }
-  return grid;
+  m_keypad1_costs = get_layer_costs(keypad1_moves, costs);
 }
 
-std::vector<std::vector<char>>
-all_shortest_paths(char src,
-                   char dst,
-                   Matrix<char> const &keypad1,
-                   Matrix<char> const &keypad2,
-                   u64 depth) {
-  auto keypad = depth == 25 ? keypad1 : keypad2;
-
-  std::unordered_map<Location, std::vector<std::vector<char>>> shortest_paths;
-  std::queue<std::pair<Location, std::vector<char>>> to_visit;
-  to_visit.emplace(find_key(src, keypad), std::vector<char>{});
-
-  while (!to_visit.empty()) {
-    auto [loc, moves] = to_visit.front();
-    auto [row, col] = loc;
-    to_visit.pop();
-
-    auto find_it = shortest_paths.find(loc);
-    if (find_it != shortest_paths.end()) {
-      if (moves.size() < find_it->second.front().size()) {
-        // we found a new shortest path
-        find_it->second.clear();
-        find_it->second.emplace_back(moves);
-      } else if (moves.size() == find_it->second.front().size()) {
-        // we found another shortest path
-        find_it->second.emplace_back(moves);
-      } else {
-        continue;
-      }
-    } else {
-      shortest_paths[loc] = {moves};
-    }
-
-    for (auto [nloc, nmove] : {
-             std::make_pair(Location{row - 1, col}, '^'),
-             std::make_pair(Location{row + 1, col}, 'v'),
-             std::make_pair(Location{row, col - 1}, '<'),
-             std::make_pair(Location{row, col + 1}, '>'),
-         }) {
-      if (keypad(nloc) == '#') {
-        continue;
-      }
-
-      auto nmoves = moves;
-      nmoves.emplace_back(nmove);
-      to_visit.emplace(nloc, nmoves);
-    }
-  }
-  return shortest_paths.find(find_key(dst, keypad))->second;
+Cost
+RobotChain::get_cost(char src, char dst) const {
+  return m_keypad1_costs[key_index(src, keypad1_keys)]
+                        [key_index(dst, keypad1_keys)];
 }
 
-u64
-get_path_with_min_cost(char src,
-                       char dst,
-                       Matrix<char> const &keypad1,
-                       Matrix<char> const &keypad2,
-                       u64 depth,
-                       std::unordered_map<cache_key, u64> &cache) {
-  cache_key key{src, dst, depth};
-  auto find_it = cache.find(key);
-  if (find_it != cache.end()) {
-    return find_it->second;
+Cost
+RobotChain::get_num_moves(std::string_view line) const {
+  Cost num_moves{};
+  char prev = 'A';
+  for (char key : line) {
+    num_moves = saturating_add(num_moves, get_cost(prev, key));
+    prev = key;
   }
-
-  auto paths = all_shortest_paths(src, dst, keypad1, keypad2, depth);
-  if (depth == 0) {
-    std::vector<char> tmp_path = paths.front();
-    tmp_path.emplace_back('A');
-    return tmp_path.size();
-  }
-
-  u64 min_cost = std::numeric_limits<u64>::max();
-  for (auto const &path : paths) {
-    u64 cost = 0;
-    std::vector<char> tmp_path{'A'};
-    append_range(tmp_path, path);
-    tmp_path.emplace_back('A');
-
-    for (auto const &window : tmp_path | std::views::slide(2)) {
-      cost += get_path_with_min_cost(window[0],
-                                     window[1],
-                                     keypad1,
-                                     keypad2,
-                                     depth - 1,
-                                     cache);
-    }
-    if (cost < min_cost) {
-      min_cost = cost;
-    }
-  }
-
-  cache[key] = min_cost;
-  return min_cost;
+  return num_moves;
 }
 } // namespace
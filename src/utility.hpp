@@ -35,6 +35,34 @@ append_range(std::vector<T> &dst, std::vector<T> const &src) {
   dst.insert(dst.end(), src.cbegin(), src.cend());
 }
 
+/// 128-bit integers for results and intermediates that overflow 64 bits;
+/// `__extension__` keeps -pedantic quiet about the GNU types
+__extension__ using uint128_t = unsigned __int128;
+__extension__ using int128_t = __int128;
+
+/// unsigned addition that clamps at the largest value instead of wrapping
+template <typename T>
+constexpr T
+saturating_add(T lhs, T rhs) {
+  T result{};
+  if (__builtin_add_overflow(lhs, rhs, &result)) {
+    return ~T{};
+  }
+  return result;
+}
+
+/// unsigned multiplication that clamps at the largest value instead of
+/// wrapping
+template <typename T>
+constexpr T
+saturating_mul(T lhs, T rhs) {
+  T result{};
+  if (__builtin_mul_overflow(lhs, rhs, &result)) {
+    return ~T{};
+  }
+  return result;
+}
+
 std::uint8_t
 get_num_digits(std::uint64_t num);
 